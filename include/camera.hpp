@@ -0,0 +1,36 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+// 2D pan/zoom camera over the map's layer-local space (the [-1,1] space
+// loadMap() normalizes into). Vertex data never changes: the camera only
+// produces the view matrix points.vert applies, so moving around costs one
+// uniform update per frame whatever the size of the map.
+struct Camera
+{
+  // layer-local point shown at the center of the viewport
+  double center[2] = { 0.0, 0.0 };
+  // 1 fits the whole layer in the viewport
+  double zoom = 1.0;
+  double minZoom = 0.25;
+  double maxZoom = 65536.0;
+
+  // viewport size in pixels, keeps the aspect ratio of the map
+  void resize(int width, int height);
+  // moves the map by a pixel offset (y down, like cursor positions)
+  void pan(double dx, double dy);
+  // zooms by `factor` keeping the layer point under pixel (x, y) in place
+  void zoomAt(double factor, double x, double y);
+  void reset();
+
+  // pixel (y down) to layer-local coordinates
+  void toLayer(double x, double y, double &lx, double &ly) const;
+  // layer-local to clip space, column-major
+  void viewMatrix(float *view) const;
+
+private:
+  int width = 1, height = 1;
+  // clip units per layer unit at zoom 1, per axis
+  double aspect[2] = { 1.0, 1.0 };
+};
+
+#endif
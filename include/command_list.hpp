@@ -0,0 +1,103 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "uniforms.hpp"
+
+struct GPUTimers;
+struct Shader;
+
+// Draw commands recorded without touching GL, so culling, LOD selection and
+// draw list construction can run on any thread (one list per layer or per
+// tile). Only replay() issues GL calls and must run on the context's thread.
+// Commands are packed into a flat word stream: recording allocates nothing
+// once a reused list has grown to its steady-state size.
+struct CommandList
+{
+  // drops the commands but keeps the allocations for the next frame
+  void clear();
+  bool empty() const { return words.empty(); }
+
+  void clear(GLbitfield mask, float r, float g, float b, float a);
+  void useProgram(Shader *shader);
+  // uniforms apply to the program of the last useProgram()
+  void setInt(const std::string &name, int value);
+  void setFloat(const std::string &name, float value);
+  void setVec2(const std::string &name, float x, float y);
+  void setMat4(const std::string &name, const float *value);
+  // the whole uniform interface struct, see Shader::setUniforms()
+  template<typename T> void setUniforms(const T &values) { setUniforms(uniformLayout<T>(), &values); }
+  void setUniforms(const UniformLayout &layout, const void *values);
+  void bindVertexArray(GLuint vao);
+  // glActiveTexture(GL_TEXTURE0 + unit) + glBindTexture
+  void bindTexture(GLuint unit, GLenum target, GLuint texture);
+  void bindFramebuffer(GLuint fbo);
+  // color attachments written by the next draws, bit i for attachment i
+  // (glDrawBuffers of an FBO, not valid on the default framebuffer)
+  void drawBuffers(GLbitfield attachments);
+  // clears draw buffer `index` of an integer attachment (glClearBufferuiv)
+  void clearBufferUint(GLint index, GLuint value);
+  // glLogicOp on every color buffer, GL_COPY (the identity) disables it
+  void logicOp(GLenum op);
+  // glBindBufferBase, e.g. GL_SHADER_STORAGE_BUFFER bindings
+  void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+  // sets every 32 bit word of `buffer` to `value` (glClearBufferData)
+  void fillBuffer(GLuint buffer, GLuint value);
+  void dispatchCompute(GLuint x, GLuint y, GLuint z);
+  void memoryBarrier(GLbitfield barriers);
+  void polygonMode(GLenum mode);
+  void lineWidth(float width);
+  void blend(bool enabled);
+  void blendFunc(GLenum sfactor, GLenum dfactor);
+  void stencilTest(bool enabled);
+  void stencilFunc(GLenum func, GLint ref, GLuint mask);
+  // glStencilOpSeparate, face is GL_FRONT, GL_BACK or GL_FRONT_AND_BACK
+  void stencilOp(GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass);
+  void colorMask(bool enabled);
+  void drawArrays(GLenum mode, GLint first, GLsizei count);
+  void drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances);
+  // one call for many ranges (glMultiDrawArrays)
+  void multiDrawArrays(GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawCount);
+  // up to maxDrawCount DrawArraysIndirectCommands from `commands`; with a
+  // `countBuffer` the GPU reads the actual count from its first word
+  // (glMultiDrawArraysIndirectCount), which needs GLEXT_indirect_count
+  void multiDrawArraysIndirect(GLenum mode, GLuint commands, GLsizei maxDrawCount, GLuint countBuffer = 0);
+
+  // GPU timer markers around a pass, see GPUTimers
+  void beginTimer(GPUTimers *timers, const std::string &pass);
+  void endTimer(GPUTimers *timers);
+
+  // appends another list's commands after ours
+  void append(const CommandList &other);
+
+  // issues the commands through the calling thread's GLState
+  void replay() const;
+  // replays several lists in order, e.g. one per layer recorded in parallel
+  static void replay(const std::vector<CommandList> &lists);
+
+private:
+  enum Op : int32_t {
+    CLEAR, USE_PROGRAM, SET_FLOAT, SET_MAT4, BIND_VERTEX_ARRAY, POLYGON_MODE,
+    LINE_WIDTH, BLEND, BLEND_FUNC, DRAW_ARRAYS, MULTI_DRAW_ARRAYS, BEGIN_TIMER,
+    END_TIMER, STENCIL_TEST, STENCIL_FUNC, STENCIL_OP, COLOR_MASK, SET_VEC2,
+    BIND_TEXTURE, DRAW_ARRAYS_INSTANCED, BIND_FRAMEBUFFER, BIND_BUFFER_BASE,
+    FILL_BUFFER, DISPATCH_COMPUTE, MEMORY_BARRIER, SET_INT, MULTI_DRAW_ARRAYS_INDIRECT,
+    DRAW_BUFFERS, CLEAR_BUFFER_UINT, LOGIC_OP, SET_UNIFORMS
+  };
+
+  std::vector<int32_t> words;
+  std::vector<Shader*> shaders;
+  std::vector<GPUTimers*> timers;
+  std::vector<std::string> names;
+  std::vector<const UniformLayout*> layouts;
+
+  void push(float value);
+  int32_t intern(const std::string &name);
+};
+
+#endif
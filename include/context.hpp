@@ -0,0 +1,93 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+
+// A GL context plus the framebuffer frames are drawn into. Loading and
+// drawing code only talks to this interface, so the same map can be shown
+// in a window or rendered on a machine without a display.
+struct Context
+{
+  virtual ~Context() {}
+
+  // false if the context could not be created
+  virtual bool valid() const = 0;
+  // implementations also reset the calling thread's GLState
+  virtual void makeCurrent() = 0;
+  // releases the context from the calling thread
+  virtual void doneCurrent() = 0;
+  // framebuffer to draw into, 0 for a window's default framebuffer
+  virtual unsigned int framebuffer() const { return 0; }
+  virtual void size(int &width, int &height) const = 0;
+  // shows the frame (buffer swap); nothing to do offscreen
+  virtual void present() = 0;
+  virtual GLADloadproc loader() const = 0;
+
+  // loads glad and our extensions, then sets up framebuffer(); the context
+  // must be current
+  bool loadGL();
+
+protected:
+  // creates offscreen targets once GL entry points are available
+  virtual void setupFramebuffer() {}
+};
+
+// On-screen context backed by a GLFW window
+struct WindowContext : Context
+{
+  GLFWwindow* window = NULL;
+
+  // with `share`, a hidden window whose context shares buffers and programs
+  // with that one, for worker threads; it is not made current
+  WindowContext(int width, int height, const char* title, WindowContext* share = NULL);
+  ~WindowContext();
+
+  bool valid() const { return window != NULL; }
+  void makeCurrent();
+  void doneCurrent();
+  void size(int &width, int &height) const;
+  void present();
+  GLADloadproc loader() const;
+
+private:
+  // the first window owns GLFW, shared ones only destroy themselves
+  bool primary = true;
+};
+
+// Offscreen context for batch servers and CI: EGL on the surfaceless Mesa
+// platform when available (llvmpipe works), a pbuffer display otherwise.
+// Frames go to an RGBA8 + depth/stencil FBO of fixed size.
+struct HeadlessContext : Context
+{
+  // with `share`, buffers and programs are shared with that context (FBOs
+  // and VAOs never are)
+  HeadlessContext(int width, int height, HeadlessContext* share = NULL);
+  ~HeadlessContext();
+
+  bool valid() const { return context != NULL; }
+  void makeCurrent();
+  void doneCurrent();
+  unsigned int framebuffer() const { return fbo; }
+  void size(int &w, int &h) const { w = width; h = height; }
+  void present();
+  GLADloadproc loader() const;
+
+protected:
+  void setupFramebuffer();
+
+private:
+  int width, height;
+  // EGLDisplay/EGLContext/EGLSurface, kept opaque so EGL (and the X11
+  // headers it may pull in) stays out of this header
+  void* display = NULL;
+  void* context = NULL;
+  void* surface = NULL;
+  unsigned int fbo = 0;
+  unsigned int colorBuffer = 0;
+  unsigned int depthStencilBuffer = 0;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef FLOW_RENDERER_H
+#define FLOW_RENDERER_H
+
+#include <vector>
+
+#include "command_list.hpp"
+#include "gpu_timer.hpp"
+#include "map.hpp"
+#include "shader.hpp"
+
+// One cell of an origin-destination matrix. Zones are shape indices of the
+// map (file order).
+struct ODPair
+{
+  int origin;
+  int destination;
+  float volume;
+};
+
+// reads "origin,destination,volume" rows (commas, semicolons or blanks);
+// lines that do not parse, like a header, are skipped. `zoneBase` is the id
+// of the first zone in the file (surveys usually number zones from 1).
+std::vector<ODPair> loadODPairs(const char* path, int zoneBase = 0);
+
+// flow.vert
+struct FlowUniforms
+{
+  float view[16];
+  float viewport[2];
+  float segments;
+  float curvature;
+  float widthRange[2];
+  float maxVolume;
+};
+UNIFORM_INTERFACE(FlowUniforms, UNIFORM(FlowUniforms, view), UNIFORM(FlowUniforms, viewport),
+                  UNIFORM(FlowUniforms, segments), UNIFORM(FlowUniforms, curvature),
+                  UNIFORM(FlowUniforms, widthRange), UNIFORM(FlowUniforms, maxVolume))
+
+// Flow layer: every OD pair is one instance of a curved arc between the two
+// zone centroids. The arc is generated in the vertex shader (flow.vert) from
+// the 12 byte per-instance record, with the centroids read from a buffer
+// texture, so millions of pairs cost 12 bytes each and a single draw call.
+struct FlowRenderer
+{
+  // same as MapRenderer's, set by the caller each frame
+  float view[16];
+  float viewport[2] = { 512.0f, 512.0f };
+  GPUTimers* timers = NULL;
+
+  // arc tessellation, triangle strip of 2*(segments+1) vertices per pair
+  int segments = 16;
+  // sideways bend of the arc, relative to the origin-destination distance;
+  // arcs bend to their right so A->B and B->A do not overlap
+  float curvature = 0.2f;
+  // pixel width of the smallest and of the largest flow
+  float minWidth = 0.5f;
+  float maxWidth = 8.0f;
+
+  // computes the zone centroids and uploads the pairs; needs a current context
+  FlowRenderer(const Map &map, std::vector<ODPair> pairs);
+  ~FlowRenderer();
+
+  // replaces the pairs (new filter, new matrix), self pairs and unknown
+  // zones are dropped; the centroids stay
+  void setPairs(std::vector<ODPair> pairs);
+
+  size_t size() const { return pairCount; }
+
+  // records the flows over whatever is already drawn (no clear)
+  void record(CommandList &list, Shader &shader) const;
+  void draw(Shader &shader);
+
+private:
+  unsigned int VAO = 0;
+  unsigned int pairVBO = 0;
+  unsigned int centroidVBO = 0;
+  unsigned int centroidTexture = 0;
+  int zones = 0;
+  int pairCount = 0;
+  float maxVolume = 1.0f;
+  CommandList frame;
+};
+
+#endif
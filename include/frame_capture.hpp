@@ -0,0 +1,119 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "image.hpp"
+
+// Screenshots and frame sequences without stalling the render loop. Each
+// captured frame is copied into a ring of pixel buffer objects with a fence
+// and only mapped a couple of frames later, when the copy is done; encoding
+// (PNG, raw RGBA or Y4M) happens on a background thread. If the encoder
+// falls too far behind, frames are dropped and counted instead of making
+// the render loop wait.
+struct FrameCapture
+{
+  // frames waiting for the encoder at most, about 8 MB each at 1080p
+  size_t maxQueued = 8;
+  // wait for the encoder instead of dropping frames, for offline rendering
+  // where nobody watches the frame rate
+  bool lossless = false;
+  // frames handed to the encoder and frames dropped since start()
+  size_t frames = 0;
+  size_t dropped = 0;
+
+  // needs a current context
+  FrameCapture();
+  // finishes every pending frame
+  ~FrameCapture();
+
+  // writes the next captured frame to `path` as PNG
+  void screenshot(const std::string &path);
+  // records every captured frame to `target`: a printf pattern with a
+  // number ("frames/%05d.png") writes a PNG per frame, "*.y4m" a YUV4MPEG2
+  // stream for video tools, anything else raw RGBA8 frames. A target
+  // starting with '|' is a command the stream is piped to
+  // ("|ffmpeg -i - out.mp4").
+  bool start(const std::string &target, int fps = 60);
+  // waits for the frames in flight, then closes the stream
+  void stop();
+  bool recording() const { return active; }
+
+  // call once a frame is drawn into `framebuffer` (0 = back buffer) and
+  // before it is presented; cheap when nothing was asked for
+  void capture(unsigned int framebuffer, int width, int height);
+
+private:
+  enum Format { SEQUENCE_PNG, STREAM_RAW, STREAM_Y4M };
+  static const int SLOTS = 3;
+
+  struct Slot
+  {
+    unsigned int pbo = 0;
+    GLsync fence = 0;
+    size_t bytes = 0;
+    int width = 0, height = 0;
+    // where the frame goes: a file, or the stream when empty
+    std::string path;
+    // part of the recording (not a screenshot)
+    bool recorded = false;
+  };
+  // everything the encoder needs, it keeps no state between jobs
+  struct Job
+  {
+    // rows bottom to top, as GL reads them
+    Image image;
+    // a PNG file, or a frame of `stream` when empty
+    std::string path;
+    FILE *stream = NULL;
+    Format format = STREAM_RAW;
+    int fps = 60;
+    bool pipe = false;
+    // the stream's first frame also writes the header
+    bool header = false;
+    // closes the stream after everything queued before it
+    bool close = false;
+  };
+
+  Slot slots[SLOTS];
+  int next = 0;
+  int inFlight = 0;
+  std::string pendingShot;
+
+  // recording state; once opened the stream is only written by the encoder
+  bool active = false;
+  Format format = STREAM_RAW;
+  std::string pattern;
+  FILE *stream = NULL;
+  bool pipe = false;
+  int fps = 60;
+  int streamWidth = 0, streamHeight = 0;
+  bool headerQueued = false;
+  // recorded frames issued, numbers the PNG sequence
+  size_t issued = 0;
+
+  std::thread encoder;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  // signalled by the encoder whenever it takes a job
+  std::condition_variable room;
+  std::deque<Job> jobs;
+  bool quit = false;
+
+  // maps the slots whose copy is done, blocking until at least `wait`
+  // slots are free
+  void collect(int wait);
+  void queue(Job job);
+  // encoder thread
+  void encode();
+  void write(Job &job);
+};
+
+#endif
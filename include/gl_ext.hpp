@@ -0,0 +1,32 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+#include <glad/glad.h>
+
+// Extensions the glad loader (core 4.6, no extensions) does not cover.
+// Call loadGLExtensions() once after gladLoadGLLoader() on every context.
+
+// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+extern int GLEXT_parallel_shader_compile;
+extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR;
+
+// glMultiDrawArraysIndirectCount: core in 4.6, GL_ARB_indirect_parameters
+// before; NULL when neither is available
+extern int GLEXT_indirect_count;
+extern PFNGLMULTIDRAWARRAYSINDIRECTCOUNTPROC glMultiDrawArraysIndirectCountAny;
+
+// glSpecializeShader (SPIR-V stages): core in 4.6, GL_ARB_gl_spirv before;
+// NULL when neither is available
+extern int GLEXT_gl_spirv;
+extern PFNGLSPECIALIZESHADERPROC glSpecializeShaderAny;
+
+// true if the current context advertises the extension
+bool hasGLExtension(const char *name);
+// resolves the entry points above using the same loader given to glad
+void loadGLExtensions(GLADloadproc load);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <ostream>
+
+// Shadow copy of the bits of GL state the renderer touches every frame.
+// Calls that would not change anything are dropped before reaching the
+// driver. Code that changes this state behind the cache's back must call
+// invalidate() afterwards.
+struct GLState
+{
+  enum Call { PROGRAM, VERTEX_ARRAY, BUFFER, POLYGON_MODE, LINE_WIDTH, BLEND, BLEND_FUNC,
+              STENCIL_TEST, COLOR_MASK, CALL_COUNT };
+
+  // calls forwarded to GL and calls elided, per kind of call
+  unsigned long issued[CALL_COUNT];
+  unsigned long skipped[CALL_COUNT];
+
+  GLState();
+
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vao);
+  void bindBuffer(GLenum target, GLuint buffer);
+  // core profile only accepts GL_FRONT_AND_BACK, so a single mode is tracked
+  void polygonMode(GLenum mode);
+  void lineWidth(GLfloat width);
+  void blend(bool enabled);
+  void blendFunc(GLenum sfactor, GLenum dfactor);
+  void stencilTest(bool enabled);
+  // all four channels at once
+  void colorMask(bool enabled);
+
+  // forget everything, the next call of each kind reaches GL
+  void invalidate();
+  // a deleted name can be handed out again, drop it from the cache
+  void forgetProgram(GLuint program);
+  void forgetBuffer(GLuint buffer);
+  void forgetVertexArray(GLuint vao);
+
+  void resetCounters();
+  // one line per kind of call: issued/skipped
+  void report(std::ostream &out) const;
+
+  // cache for the context current on the calling thread
+  static GLState& current();
+
+private:
+  static const GLuint UNKNOWN = ~0u;
+  static const int BUFFER_TARGETS = 12;
+
+  GLuint program;
+  GLuint vertexArray;
+  GLenum bufferTarget[BUFFER_TARGETS];
+  GLuint buffer[BUFFER_TARGETS];
+  GLenum mode;
+  GLfloat width;
+  int blending;
+  GLenum blendSrc, blendDst;
+  int stencil;
+  int colorWrites;
+
+  GLuint* bufferSlot(GLenum target);
+  bool changed(Call call, bool differs);
+};
+
+#endif
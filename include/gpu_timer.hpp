@@ -0,0 +1,68 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-pass GPU times from glQueryCounter(GL_TIMESTAMP) pairs, which unlike
+// GL_TIME_ELAPSED may nest. Queries of a frame are only read back `latency`
+// frames later, when the GPU has long finished them, so timing never stalls
+// the pipeline; the few that are still pending by then are dropped.
+struct GPUTimers
+{
+  struct Stats
+  {
+    double minMs = 0;
+    double avgMs = 0;
+    double p99Ms = 0;
+    size_t samples = 0;
+  };
+
+  // `history` samples per pass are kept for the statistics
+  GPUTimers(int latency = 4, size_t history = 256);
+  ~GPUTimers();
+
+  void begin(const std::string &pass);
+  // closes the innermost open pass
+  void end();
+  // call once per frame after the last pass (e.g. after the buffer swap)
+  void endFrame();
+
+  Stats stats(const std::string &pass) const;
+  // one line per pass: min/avg/p99 in milliseconds
+  void report(std::ostream &out) const;
+
+private:
+  struct Pending
+  {
+    int pass;
+    GLuint start, end;
+  };
+
+  std::vector<std::vector<Pending> > frames;
+  size_t current = 0;
+  std::vector<size_t> open;
+  std::vector<GLuint> freeQueries;
+
+  std::vector<std::string> passes;
+  std::vector<std::vector<double> > samples;
+  std::vector<size_t> cursor;
+  size_t history;
+
+  int passIndex(const std::string &pass);
+  GLuint query();
+  void collect(std::vector<Pending> &frame);
+};
+
+// times the enclosing scope
+struct ScopedGPUTimer
+{
+  GPUTimers &timers;
+  ScopedGPUTimer(GPUTimers &timers, const std::string &pass) : timers(timers) { timers.begin(pass); }
+  ~ScopedGPUTimer() { timers.end(); }
+};
+
+#endif
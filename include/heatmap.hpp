@@ -0,0 +1,70 @@
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <vector>
+
+#include "command_list.hpp"
+#include "gpu_timer.hpp"
+#include "map.hpp"
+#include "shader.hpp"
+
+// heat_splat.vert
+struct SplatUniforms
+{
+  float view[16];
+  float viewport[2];
+  float radius;
+};
+UNIFORM_INTERFACE(SplatUniforms, UNIFORM(SplatUniforms, view), UNIFORM(SplatUniforms, viewport),
+                  UNIFORM(SplatUniforms, radius))
+
+// Density layer. Three passes per frame:
+//  1. splat: every weighted point is an instanced quad with a smooth kernel
+//     added (GL_ONE, GL_ONE) into an R32F texture of the framebuffer's size
+//  2. reduce: a compute pass finds the texture's max, a workgroup reduction
+//     in shared memory followed by one atomicMax per workgroup
+//  3. color: a fullscreen pass maps density / max through a color ramp and
+//     blends it over the map
+// Nothing is read back, the max goes from the compute pass to the color
+// pass through a storage buffer.
+struct HeatmapRenderer
+{
+  float view[16];
+  float viewport[2] = { 512.0f, 512.0f };
+  // framebuffer the map is drawn into, the heatmap is composited over it
+  unsigned int targetFramebuffer = 0;
+  GPUTimers* timers = NULL;
+  // kernel radius in pixels
+  float radius = 24.0f;
+
+  // needs a current context
+  HeatmapRenderer();
+  ~HeatmapRenderer();
+
+  // X, Y, weight per point in the map's normalized space
+  void setPoints(const std::vector<float> &points);
+  size_t size() const { return pointCount; }
+  // reallocates the density texture when the framebuffer size changed
+  void resize(int width, int height);
+
+  // splat, reduce (compute) and color programs
+  void record(CommandList &list, Shader &splat, Shader &reduce, Shader &color) const;
+  void draw(Shader &splat, Shader &reduce, Shader &color);
+
+private:
+  unsigned int VAO = 0;
+  unsigned int emptyVAO = 0;
+  unsigned int pointVBO = 0;
+  unsigned int fbo = 0;
+  unsigned int density = 0;
+  // density max, as the bits of a positive float (they order like uints)
+  unsigned int maxBuffer = 0;
+  int width = 0, height = 0;
+  int pointCount = 0;
+  CommandList frame;
+};
+
+// "x,y[,weight]" rows in the map file's coordinates, as setPoints() input
+std::vector<float> loadPoints(const char* path, const Map &map);
+
+#endif
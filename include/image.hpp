@@ -0,0 +1,35 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <glad/glad.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// 8-bit RGBA pixels, rows stored top to bottom
+struct Image
+{
+  int width = 0;
+  int height = 0;
+  std::vector<unsigned char> pixels;
+};
+
+// reads the color attachment of `framebuffer` (0 = back buffer)
+Image readFramebuffer(unsigned int framebuffer, int width, int height);
+
+// reverses the row order (GL reads bottom-up)
+void flipRows(Image &image);
+
+bool writePNG(const std::string &path, const Image &image);
+// headerless RGBA8 rows, top to bottom (e.g. for ffmpeg -f rawvideo)
+bool writeRaw(const std::string &path, const Image &image);
+// one more frame of a raw RGBA8 stream
+bool writeRawFrame(FILE *file, const Image &image);
+// YUV4MPEG2 (4:2:0, full range BT.601), readable by ffmpeg, mpv and x264
+bool writeY4MHeader(FILE *file, int width, int height, int fps);
+bool writeY4MFrame(FILE *file, const Image &image);
+// picks the format from the extension: .png or anything else as raw
+bool writeImage(const std::string &path, const Image &image);
+
+#endif
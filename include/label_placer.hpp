@@ -0,0 +1,68 @@
+#ifndef LABEL_PLACER_H
+#define LABEL_PLACER_H
+
+#include <vector>
+
+// Greedy label collision: labels are taken by priority and one is shown
+// when its box does not overlap a box already shown. Boxes are looked up
+// in a uniform grid of screen cells (hashed, so the grid has no bounds),
+// which keeps every test local instead of against every other label.
+//
+// Positions are kept in pixels relative to the view's translation, so a
+// pan moves no label: only the labels entering or leaving the viewport
+// are placed again, and the decisions they change are propagated to the
+// lower priority neighbours of their boxes. A zoom or resize moves every
+// label and places them all from scratch.
+struct LabelPlacer
+{
+  // pixels kept free between two labels
+  float margin = 2.0f;
+  // 1 for the labels placed by the last place(), per label
+  std::vector<unsigned char> visible;
+  int placedCount = 0;
+  // duration of the last place() that changed something
+  double lastMs = 0.0;
+
+  // anchors: X, Y per label in the map's normalized space; sizes: width,
+  // height per label in pixels; higher priority labels are placed first
+  // (ties in label order). Invalidates the placement.
+  void setLabels(const std::vector<float> &anchors, const std::vector<float> &sizes,
+                 const std::vector<float> &priority);
+
+  // places the labels for `view` (column major, as the shaders get it) and
+  // a viewport in pixels; false when no label changed visibility
+  bool place(const float *view, const float *viewport);
+
+private:
+  struct Box { float x0, y0, x1, y1; };
+
+  std::vector<float> anchors, sizes;
+  // position of each label in the priority order, and the order itself
+  std::vector<int> rank, order;
+  std::vector<Box> boxes;
+  std::vector<unsigned char> inView;
+  // linear part of the last view and the viewport, boxes depend on them
+  float scale[6];
+  bool valid = false;
+
+  // grid cells hashed into a fixed number of buckets of label indices:
+  // every label in view, and the placed ones (collisions only test those)
+  std::vector<std::vector<int>> candidates, shown;
+  // labels waiting to be decided again, a min-heap on rank
+  std::vector<int> heap;
+  std::vector<unsigned char> queued;
+
+  bool overlaps(const Box &a, const Box &b) const;
+  std::vector<int>& bucket(std::vector<std::vector<int>> &grid, int cx, int cy);
+  void insert(std::vector<std::vector<int>> &grid, int label);
+  void remove(std::vector<std::vector<int>> &grid, int label);
+  // a higher priority label already placed overlaps `label`
+  bool blocked(int label);
+  // queues the lower priority labels overlapping `box`
+  void queueBelow(int label, const Box &box);
+  void queue(int label);
+  // every label from scratch
+  void placeAll(const Box &region);
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef LABEL_RENDERER_H
+#define LABEL_RENDERER_H
+
+#include <string>
+#include <vector>
+
+#include "command_list.hpp"
+#include "gpu_timer.hpp"
+#include "sdf_font.hpp"
+#include "shader.hpp"
+
+// label.vert + label.frag, the atlas layout comes from GlyphAtlas
+struct LabelUniforms
+{
+  float view[16];
+  float viewport[2];
+  // pixels per font unit
+  float unitPixels;
+  int columns;
+  float cell[2];
+  float atlasSize[2];
+  float texelsPerUnit;
+  float padding;
+  float spread;
+};
+UNIFORM_INTERFACE(LabelUniforms, UNIFORM(LabelUniforms, view), UNIFORM(LabelUniforms, viewport),
+                  UNIFORM(LabelUniforms, unitPixels), UNIFORM(LabelUniforms, columns),
+                  UNIFORM(LabelUniforms, cell), UNIFORM(LabelUniforms, atlasSize),
+                  UNIFORM(LabelUniforms, texelsPerUnit), UNIFORM(LabelUniforms, padding),
+                  UNIFORM(LabelUniforms, spread))
+
+// A line of text centered on a point of the map's normalized space
+struct Label
+{
+  float x, y;
+  std::string text;
+};
+
+// Text layer. Every glyph of every label is one instance of a quad sampling
+// the signed distance field atlas (sdf_font.hpp), so all labels are drawn by
+// a single instanced call and stay sharp whatever the size or zoom. Labels
+// keep their pixel size, only their anchors follow the view. Which labels
+// show is a byte per label (see LabelPlacer), the glyphs are never rebuilt.
+struct LabelRenderer
+{
+  // same as MapRenderer's, set by the caller each frame
+  float view[16];
+  float viewport[2] = { 512.0f, 512.0f };
+  GPUTimers* timers = NULL;
+  // cap height in pixels
+  float textSize = 12.0f;
+
+  // builds and uploads the glyph atlas; needs a current context
+  LabelRenderer();
+  ~LabelRenderer();
+
+  // replaces every label (one glyph instance per non blank character), all
+  // of them visible
+  void setLabels(const std::vector<Label> &labels);
+  size_t size() const { return glyphCount; }
+  // 0 hides a label, one byte per label of setLabels()
+  void setVisible(const std::vector<unsigned char> &visible);
+  // pixel width and height of `text` at textSize, halo included
+  void extent(const std::string &text, float &width, float &height) const;
+
+  // records the labels over whatever is already drawn (no clear)
+  void record(CommandList &list, Shader &shader) const;
+  void draw(Shader &shader);
+
+private:
+  // per instance: label anchor, pen position in font units, atlas cell and
+  // the label it belongs to
+  struct Glyph
+  {
+    float anchor[2];
+    float offset[2];
+    int cell;
+    int label;
+  };
+
+  GlyphAtlas atlas;
+  unsigned int VAO = 0;
+  unsigned int glyphVBO = 0;
+  unsigned int atlasTexture = 0;
+  unsigned int visibleVBO = 0;
+  unsigned int visibleTexture = 0;
+  int glyphCount = 0;
+  int labelCount = 0;
+  CommandList frame;
+};
+
+#endif
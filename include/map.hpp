@@ -0,0 +1,52 @@
+#ifndef MAP_H
+#define MAP_H
+
+#include <string>
+#include <vector>
+
+// Polygon layer read from a shapefile, one triangle fan / line loop per ring
+struct Map
+{
+  // X, Y, Z per vertex, normalized into [-1,1] once at load:
+  // normalized = (projected - center) * scale. This layer-local space is
+  // fixed, views (camera, tiles) are applied by the view matrix uniform
+  std::vector<float> points;
+  // number of vertices of each shape, in file order
+  std::vector<int> shapeCounts;
+  // number of vertices of each ring (shapefile part), in file order: a
+  // shape's rings follow each other and add up to its shapeCounts entry
+  std::vector<int> ringCounts;
+  // extent of the data in projected coordinates
+  double minBound[2];
+  double maxBound[2];
+  double center[2];
+  double scale;
+  // the file was lon/lat, projected to web mercator at load
+  bool webMercator = false;
+};
+
+// a point in the file's coordinates to the normalized space of `map`
+void normalizePoint(const Map &map, double x, double y, float &nx, float &ny);
+
+// area weighted centroid of every shape (holes subtract), X, Y per shape in
+// the normalized space; shapes with no area fall back to their vertex mean
+std::vector<float> shapeCentroids(const Map &map);
+
+// area of every shape in the normalized space (holes subtract)
+std::vector<float> shapeAreas(const Map &map);
+
+// default dataset: the OD 1987 survey zones
+extern const char* DEFAULT_MAP_PATH;
+
+// lon/lat degrees to spherical (web) mercator meters, in place
+void projectWebMercator(double &x, double &y);
+
+// reads every shape of `path` (without the .shp extension); exits on failure.
+// With `webMercator` the file is taken as lon/lat and projected to EPSG:3857.
+Map loadMap(const char* path, bool webMercator = false);
+
+// `field` of every record of the shapefile's .dbf, as text, in shape order;
+// empty when the table or the field is missing
+std::vector<std::string> loadAttribute(const char* path, const char* field);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef OD_MATRIX_H
+#define OD_MATRIX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "flow_renderer.hpp"
+
+// Raw survey trips, one column per attribute so filters only touch the
+// columns they test. Zones are 0-based shape indices like ODPair's.
+struct TripTable
+{
+  std::vector<int32_t> origin;
+  std::vector<int32_t> destination;
+  std::vector<uint8_t> purpose;
+  std::vector<uint8_t> mode;
+  // hour of departure, 0-23
+  std::vector<uint8_t> hour;
+  // expansion factor of the trip, 1 when the file has none
+  std::vector<float> weight;
+
+  size_t size() const { return origin.size(); }
+  void push(int32_t o, int32_t d, int p, int m, int h, float w);
+};
+
+// Reads a trip table. Files starting with the TRIP magic are the binary
+// format of writeTripsBinary(), anything else is CSV: comma, semicolon or
+// blank separated, with an optional header naming the columns (origin,
+// destination, purpose, mode, hour, weight in any order, missing ones
+// default to 0 and weight 1); without a header that is the column order.
+// `zoneBase` is the id of the first zone in the file. Returns false when
+// the file cannot be read.
+bool loadTrips(const char* path, TripTable &trips, int zoneBase = 0);
+// packed binary copy of a table, loads without parsing
+bool writeTripsBinary(const char* path, const TripTable &trips);
+
+// Which trips an aggregation counts: one bit per purpose, mode and hour
+struct TripFilter
+{
+  uint64_t purposes = ~0ull;
+  uint64_t modes = ~0ull;
+  uint32_t hours = 0xFFFFFF;
+
+  bool accepts(int purpose, int mode, int hour) const {
+    return (purposes >> (purpose & 63) & 1) && (modes >> (mode & 63) & 1) && (hours >> (hour % 24) & 1);
+  }
+  // keeps hours first..last (inclusive, wraps around midnight, both taken
+  // modulo 24)
+  void hourRange(int first, int last);
+};
+
+// Sparse zone to zone matrix in CSR form: row o holds the destinations
+// columns[rowStart[o] .. rowStart[o+1]) in increasing order
+struct ODMatrix
+{
+  int zones = 0;
+  std::vector<int> rowStart;
+  std::vector<int> columns;
+  std::vector<float> values;
+  // trips produced by (row) and attracted to (column) each zone
+  std::vector<double> rowTotals;
+  std::vector<double> columnTotals;
+  double total = 0;
+
+  size_t nonZeros() const { return values.size(); }
+  float at(int origin, int destination) const;
+  // the cells as flow layer input
+  std::vector<ODPair> pairs() const;
+};
+
+// Sums the trip weights per (origin, destination) over the trips the
+// filter accepts. Trips are split between `threads` workers (0: one per
+// core), each summing into its own hash map; the maps are then merged into
+// the CSR matrix. Trips with zones outside [0, zones) are ignored.
+ODMatrix aggregateTrips(const TripTable &trips, int zones, const TripFilter &filter = TripFilter(), int threads = 0);
+
+#endif
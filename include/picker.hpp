@@ -0,0 +1,52 @@
+#ifndef PICKER_H
+#define PICKER_H
+
+#include <glad/glad.h>
+
+// Zone under the cursor without a CPU point-in-polygon test. The map is
+// drawn into our FBO, whose second color attachment (R32UI) gets the zone
+// of every pixel from the fill pass itself (MapRenderer::pickIds); the color
+// is then blitted to the real target. A lookup copies one texel into a
+// pixel buffer object and fences it, and the result is only read once the
+// fence has passed, so picking never waits for the GPU and costs the same
+// for any polygon.
+struct Picker
+{
+  // zone of the last completed lookup, -1 for none
+  int zone = -1;
+
+  // needs a current context
+  Picker();
+  ~Picker();
+
+  // framebuffer the map has to be drawn into
+  unsigned int framebuffer() const { return fbo; }
+  // reallocates the attachments when the framebuffer size changed
+  void resize(int width, int height);
+  // copies the drawn color to `target`
+  void blit(unsigned int target) const;
+
+  // queues a lookup of pixel x, y (GL convention, y up) of the last frame;
+  // when every slot is in flight the oldest request is dropped
+  void request(int x, int y);
+  // collects finished lookups without blocking; true when `zone` changed
+  bool poll();
+  // a lookup is still in flight
+  bool pending() const { return inFlight > 0; }
+
+private:
+  static const int SLOTS = 3;
+
+  unsigned int fbo = 0;
+  unsigned int color = 0;
+  unsigned int ids = 0;
+  unsigned int depthStencil = 0;
+  int width = 0, height = 0;
+  // ring of PBOs, each with the fence of its copy
+  unsigned int pbos[SLOTS];
+  GLsync fences[SLOTS];
+  int next = 0;
+  int inFlight = 0;
+};
+
+#endif
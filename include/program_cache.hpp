@@ -0,0 +1,39 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Entries are keyed by a hash of the shader sources plus GL_RENDERER and
+// GL_VERSION, so another GPU or a driver update simply misses and recompiles.
+struct ProgramCache
+{
+  // directory holding the binaries, empty disables the cache
+  std::string dir;
+
+  ProgramCache(const std::string &dir);
+
+  // cache key for the given sources on the current context
+  std::string key(const std::vector<std::string> &sources);
+  // returns a linked program read from disk, or 0 on miss or driver rejection
+  unsigned int load(const std::string &key);
+  // writes the binary of a linked program under key
+  bool store(const std::string &key, unsigned int program);
+
+  // process wide cache, directory taken from $LEARNOPENGL_SHADER_CACHE
+  // (defaults to "shader_cache", set it empty to disable)
+  static ProgramCache& instance();
+
+private:
+  // -1 unknown, 0 driver has no binary formats, 1 usable
+  int supported = -1;
+  std::vector<GLint> formats;
+
+  bool enabled();
+  std::string path(const std::string &key) const;
+};
+
+#endif
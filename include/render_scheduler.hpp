@@ -0,0 +1,36 @@
+#ifndef RENDER_SCHEDULER_H
+#define RENDER_SCHEDULER_H
+
+#include <atomic>
+#include <functional>
+
+// Decides when a frame has to be drawn. Input, resizes and data updates
+// mark the frame dirty, animations keep it dirty until they end, and in
+// between the event loop sleeps instead of redrawing a static map.
+struct RenderScheduler
+{
+  // redraw every iteration, the old busy loop (benchmarks, profiling)
+  bool continuous = false;
+  // upper bound for a single sleep, so clocks and watchers still get a turn
+  double idleTimeout = 0.5;
+  // wakes the sleeping event loop, e.g. glfwPostEmptyEvent
+  std::function<void()> wake;
+
+  // something on screen changed; safe to call from any thread
+  void invalidate();
+  // keep redrawing for the next `seconds` (transitions, animated layers)
+  void animate(double seconds, double now);
+
+  bool needsRedraw(double now) const;
+  // how long the event loop may block before the next frame is due, 0 to poll
+  double timeout(double now) const;
+  // call before drawing: invalidations arriving while the frame is being
+  // drawn stay pending and trigger the next one
+  void beginFrame();
+
+private:
+  std::atomic<bool> dirty{true};
+  double animateUntil = 0;
+};
+
+#endif
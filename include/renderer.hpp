@@ -0,0 +1,135 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <string>
+#include <vector>
+
+#include "command_list.hpp"
+#include "gpu_timer.hpp"
+#include "map.hpp"
+#include "shader.hpp"
+
+// points.vert + static_color.frag
+struct MapUniforms
+{
+  float view[16];
+  // 1 fills, 0 outlines (map_color.glsl)
+  float c;
+};
+UNIFORM_INTERFACE(MapUniforms, UNIFORM(MapUniforms, view), UNIFORM(MapUniforms, c))
+
+// aa_line.vert + aa_line.frag
+struct LineUniforms
+{
+  float view[16];
+  float viewport[2];
+  float width;
+  float c;
+};
+UNIFORM_INTERFACE(LineUniforms, UNIFORM(LineUniforms, view), UNIFORM(LineUniforms, viewport),
+                  UNIFORM(LineUniforms, width), UNIFORM(LineUniforms, c))
+
+// cull.comp
+struct CullUniforms
+{
+  float view[16];
+  // 1 packs the surviving commands (indirect count), 0 zeroes the culled ones
+  int compact;
+};
+UNIFORM_INTERFACE(CullUniforms, UNIFORM(CullUniforms, view), UNIFORM(CullUniforms, compact))
+
+// GPU side of a loaded map and the passes that draw it. Used unchanged by
+// the window and by offscreen contexts.
+struct MapRenderer
+{
+  enum FillMode
+  {
+    // one triangle fan per ring: no preprocessing, wrong for concave shapes
+    // and holes
+    FILL_FAN,
+    // stencil-then-cover: fans only count coverage in the stencil buffer,
+    // then a bounding quad is drawn where the count says "inside". Correct
+    // for concave shapes, holes and multipart shapes with no triangulation.
+    FILL_STENCIL_EVEN_ODD,
+    FILL_STENCIL_NONZERO
+  };
+
+  unsigned int VAO = 0;
+  unsigned int VBO = 0;
+  std::vector<int> shapeCounts;
+  // first vertex of each shape
+  std::vector<int> shapeFirsts;
+  // first vertex and vertex count of each ring, for glMultiDrawArrays: the
+  // fill and outline passes draw rings, never a shape's whole vertex run
+  std::vector<int> ringFirsts;
+  std::vector<int> ringCounts;
+  // normalized map space to clip space, column-major, identity by default
+  float view[16];
+  // when set, the fill and outline passes are timed on the GPU
+  GPUTimers* timers = NULL;
+  // stencil modes need a stencil buffer in the target framebuffer
+  FillMode fillMode = FILL_FAN;
+  // analytic anti-aliasing: when set (aa_line program), outlines are drawn
+  // as screen space quads with per-pixel edge coverage instead of GL lines
+  Shader* lineShader = NULL;
+  // also smooth the fill's staircase edges with a 1px coverage fringe,
+  // skipped when an outline of 1px or more covers them
+  bool fillEdgeAA = false;
+  // in pixels, 0 hides the outlines
+  float outlineWidth = 1.2f;
+  // GPU culling: when set (cull.comp), a compute pass tests every shape's
+  // bounding box against the view and writes the indirect draw commands of
+  // the fill and outline passes, the CPU does nothing per shape
+  Shader* cullShader = NULL;
+  // framebuffer size in pixels, the AA line widths are in pixels
+  float viewport[2] = { 512.0f, 512.0f };
+  // picking: the fill pass also writes each pixel's zone (shape index + 1,
+  // 0 for none) to color attachment 1 of the bound FBO (see Picker)
+  bool pickIds = false;
+
+  // uploads the map's vertices, needs a current context
+  MapRenderer(const Map &map);
+  // draws the vertices `shared` already uploaded from another context of the
+  // same share group; only the VAO (not shareable) is created here
+  MapRenderer(const MapRenderer &shared);
+  ~MapRenderer();
+
+  // records clearing the framebuffer and the fill and outline passes with
+  // the static color program; touches no GL state, callable from any thread
+  void record(CommandList &list, Shader &shader) const;
+  // records and replays right away on the calling (GL) thread
+  void draw(Shader &shader);
+
+private:
+  bool ownsBuffer = true;
+  // the cover quad's 4 vertices follow the map's in the VBO
+  int coverFirst = 0;
+  // AA lines: first vertex of every ring segment, read per instance, with
+  // the vertices fetched through a buffer texture over the VBO
+  unsigned int segmentVBO = 0;
+  unsigned int pointsTexture = 0;
+  unsigned int lineVAO = 0;
+  int segmentCount = 0;
+  // shape index of every vertex, the fill's flat zone id attribute
+  unsigned int zoneVBO = 0;
+  // GPU culling inputs (shared between contexts) and outputs (per renderer)
+  unsigned int boundsBuffer = 0;
+  unsigned int rangesBuffer = 0;
+  unsigned int commandBuffer = 0;
+  unsigned int countBuffer = 0;
+  CommandList frame;
+  void setupShapes();
+  void setupSegments(const Map &map);
+  void setupZones();
+  void setupBounds(const Map &map);
+  void setupCommandBuffers();
+  // the fill/outline draw of every ring, direct or from the cull pass
+  void recordShapes(CommandList &list, GLenum mode) const;
+  void recordLines(CommandList &list, float c, float width) const;
+  void setupVertexArray();
+};
+
+// "fan", "stencil" (even-odd) or "nonzero"; false for anything else
+bool parseFillMode(const std::string &name, MapRenderer::FillMode &mode);
+
+#endif
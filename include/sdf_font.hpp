@@ -0,0 +1,39 @@
+#ifndef SDF_FONT_H
+#define SDF_FONT_H
+
+#include <string>
+#include <vector>
+
+// Signed distance field atlas of the bundled stroke font (sdf_font.cpp).
+// Glyphs are polylines on a 4x6 unit grid (baseline at 0, cap height 6),
+// rasterized on the CPU as the exact distance to their strokes, so a single
+// small atlas stays crisp at any label size.
+struct GlyphAtlas
+{
+  // one cell per glyph, `columns` cells per row; one byte per texel with
+  // 128 on the stroke edge, growing inside (see `spread`)
+  int cellWidth = 0, cellHeight = 0;
+  int columns = 0;
+  int width = 0, height = 0;
+  std::vector<unsigned char> pixels;
+
+  // font units: the cell covers [-padding, 4 + padding] x [-padding, 6 + padding]
+  float texelsPerUnit = 0.0f;
+  float padding = 0.0f;
+  // distance (font units) between 128 and 0 or 255
+  float spread = 0.0f;
+  float advance = 6.0f;
+  float capHeight = 6.0f;
+
+  // cell of `c`: lowercase maps to uppercase, unknown characters to '?',
+  // -1 for blanks (nothing to draw)
+  int glyph(char c) const;
+
+  // characters of each cell, in cell order
+  std::string charset;
+};
+
+// rasterizes every glyph of the bundled font, a few milliseconds
+GlyphAtlas buildGlyphAtlas(int texelsPerUnit = 6);
+
+#endif
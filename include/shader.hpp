@@ -3,24 +3,118 @@
 
 #include <glad/glad.h>
 
+#include <atomic>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "shader_source.hpp"
+#include "uniforms.hpp"
 
 struct  Shader
 {
     // the program ID
     unsigned int ID;
   
-    // constructor reads and builds the shader
-    Shader(const GLchar* vertexPath, const GLchar* fragmentPath);
-    // use/activate the shader
+    // constructor reads the sources (see preprocessShader: #include and
+    // `defines`) and submits the build to the driver, it does not wait for
+    // compilation to finish. Stages embedded as SPIR-V (loadSpirv) are
+    // specialized from the same defines instead, when the driver takes
+    // SPIR-V (GL 4.6 or GL_ARB_gl_spirv) and every stage has a module.
+    Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const ShaderDefines &defines = ShaderDefines());
+    // compute program, use() waits for it instead of binding the placeholder
+    explicit Shader(const GLchar* computePath, const ShaderDefines &defines = ShaderDefines());
+    // use/activate the shader, binds a placeholder while still compiling
     void use();
+    // true once the program can be used without blocking
+    bool ready();
+    // blocks until the program is linked, reports errors and caches it
+    void finish();
+    // reads the source files again, compiles and links them synchronously on
+    // the calling thread's context, which must share objects with the one
+    // drawing (see ShaderWatcher). On success the new program replaces ID at
+    // the next use(); on errors they are printed and the old one stays.
+    bool rebuild();
+    // source files, vertex then fragment (or the compute stage alone)
+    const std::vector<std::string>& paths() const { return sourcePaths; }
+    // paths() and the files they include, as read by the constructor
+    const std::vector<std::string>& dependencies() const { return dependencyPaths; }
     // utility uniform functions
     void setBool(const std::string &name, bool value) const;  
     void setInt(const std::string &name, int value) const;   
     void setFloat(const std::string &name, float value) const;
+    void setVec2(const std::string &name, float x, float y) const;
+    // column-major 4x4 matrix
+    void setMat4(const std::string &name, const float *value) const;
+    // uploads the members of a uniform interface struct (uniforms.hpp) that
+    // changed since the last upload, without name lookups. The interface is
+    // checked against the program's active uniforms the first time, and
+    // again once a rebuild replaced the program.
+    template<typename T> void setUniforms(const T &values) { setUniforms(uniformLayout<T>(), &values); }
+    void setUniforms(const UniformLayout &layout, const void *values);
+
+private:
+    // shaders still attached while the driver compiles them
+    unsigned int vertex = 0;
+    unsigned int fragment = 0;
+    bool linked = false;
+    bool compute = false;
+    std::string cacheKey;
+    std::vector<std::string> sourcePaths;
+    ShaderDefines defines;
+    std::vector<std::string> dependencyPaths;
+    // one module per stage when built from SPIR-V, empty for GLSL
+    std::vector<SpirvModule> spirv;
+    // program linked by rebuild() on another thread, waiting for use()
+    std::atomic<unsigned int> replacement{0};
+    // interface of the last setUniforms(), per member its location (-1 when
+    // the program has no such uniform) and whether it was uploaded; values
+    // holds what was uploaded, laid out like the struct
+    const UniformLayout *boundLayout = NULL;
+    std::vector<GLint> uniformLocations;
+    std::vector<bool> uniformUploaded;
+    std::vector<unsigned char> uniformValues;
+
+    // submits the program, going through the on-disk binary cache first
+    void build(const std::string &vertexCode, const std::string &fragmentCode);
+    // preprocessed stages, false if a file is missing; `files` gets dependencies()
+    bool readSources(std::string &vertexCode, std::string &fragmentCode, std::vector<std::string> *files = NULL) const;
+    // SPIR-V modules of all stages into `spirv`, false (and none) otherwise
+    bool loadModules();
+    // specializes stage `index`'s SPIR-V module, or compiles `code`
+    unsigned int compileStage(GLenum type, size_t index, const std::string &code) const;
+    // creates the stages and the program and submits the link, no status query
+    unsigned int submit(const std::string &vertexCode, const std::string &fragmentCode,
+                        unsigned int &vertexShader, unsigned int &fragmentShader) const;
+    // prints compile and link errors, true if the program linked; then
+    // detaches and deletes the stages
+    bool check(unsigned int program, unsigned int vertexShader, unsigned int fragmentShader) const;
+    // checks `layout` against the active uniforms and looks up the locations
+    void bindUniforms(const UniformLayout &layout);
+    // flat grey program drawn while the real one is pending
+    static unsigned int placeholder();
+};
+
+// Variants of one program that differ by their defines (vertex attributes
+// present, picking, ...). A variant is only read and compiled the first
+// time it is asked for, and asking again returns the same Shader. On disk
+// each variant is its own ProgramCache entry, since the key hashes the
+// expanded sources, defines included.
+struct ShaderPermutations
+{
+  // NULL fragmentPath for a compute program
+  ShaderPermutations(const char* vertexPath, const char* fragmentPath);
+
+  Shader& get(const ShaderDefines &defines = ShaderDefines());
+  // the variants built so far
+  std::vector<Shader*> built() const;
+
+private:
+  std::string vertexPath, fragmentPath;
+  std::map<ShaderDefines, std::unique_ptr<Shader>> programs;
 };
 
 #endif
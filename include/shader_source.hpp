@@ -0,0 +1,55 @@
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Macros for one variant of a program, NAME -> value (may be empty).
+// Ordered, so the same set always expands to the same text and hits the
+// same program cache entry.
+typedef std::map<std::string, std::string> ShaderDefines;
+
+// Shader files are named relative to the shader directory ("points.vert").
+// By default they come from the copies compiled into the binary (the
+// Makefile embeds src/shaders), so starting up reads no shader file. For
+// development $LEARNOPENGL_SHADER_DIR (or setShaderDirectory) names a
+// directory read instead, e.g. src/shaders with --watch-shaders. Absolute
+// paths are always read from disk.
+const std::string& shaderDirectory();
+void setShaderDirectory(const std::string &dir);
+// the file `name` is read from, empty when it comes from the binary
+std::string shaderFile(const std::string &name);
+
+// Expands a shader file for the compiler. `#include "file"` lines are
+// replaced by that file, relative to the including one and each file at
+// most once (so there is no need for guards); `defines` go right after the
+// #version line. #line directives keep compiler messages on the right
+// line, with the file's index in `files` as the source string number.
+// Returns an empty string (and prints the error) if a file is missing.
+// `files` gets the names read, `path` first.
+std::string preprocessShader(const std::string &path, const ShaderDefines &defines,
+                             std::vector<std::string> *files = NULL);
+
+// A stage precompiled to SPIR-V by `make spirv` ("points.vert" ->
+// points.vert.spv), embedded next to the sources, with the specialization
+// constants for one variant. Each define sets the constant of the same
+// name (the module's OpName), an empty value meaning true; defines the
+// module has no constant for are ignored, like an unused macro.
+struct SpirvModule
+{
+  std::vector<uint32_t> words;
+  // glSpecializeShader arguments
+  std::vector<unsigned int> constantIds;
+  std::vector<unsigned int> constantValues;
+};
+// false when `name` has no embedded module, when it is read from a shader
+// directory (the GLSL is what is being edited) or when a define's value
+// does not fit its constant
+bool loadSpirv(const std::string &name, const ShaderDefines &defines, SpirvModule &module);
+
+// "A=1,B" style description of a define set, for logs
+std::string describeDefines(const ShaderDefines &defines);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "context.hpp"
+#include "shader.hpp"
+
+// Shader hot reload, for iterating on styles without reloading the data.
+// A thread waits on inotify for the shaders' source files to be written,
+// then rebuilds the programs using them on its own context (sharing objects
+// with the drawing one), so compiling never stalls a frame. A program that
+// fails to compile or link is reported and the old one keeps drawing; a
+// good one is swapped in by the next Shader::use().
+struct ShaderWatcher
+{
+  // takes `context`, made current on the watcher thread; `reloaded` runs on
+  // that thread after a program was replaced (e.g. to schedule a redraw).
+  // The shaders must outlive the watcher.
+  ShaderWatcher(Context *context, const std::vector<Shader*> &shaders, std::function<void()> reloaded);
+  ~ShaderWatcher();
+
+  // false if inotify is unavailable, nothing is watched then
+  bool valid() const { return notify >= 0; }
+
+private:
+  std::unique_ptr<Context> context;
+  std::function<void()> reloaded;
+  int notify = -1;
+  // written by the destructor to end the thread's poll()
+  int quit[2] = { -1, -1 };
+  // (watched directory, file name) -> shaders built from that file
+  std::map<std::pair<int, std::string>, std::vector<Shader*>> files;
+  std::thread thread;
+
+  void run();
+  void rebuild(const std::vector<Shader*> &changed);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef UNIFORMS_H
+#define UNIFORMS_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <type_traits>
+
+// Typed uniform interfaces. Each program's uniforms are a plain struct whose
+// members are named after the GLSL uniforms, described once at compile time:
+//
+//   struct LineUniforms { float view[16]; float width; };
+//   UNIFORM_INTERFACE(LineUniforms, UNIFORM(LineUniforms, view), UNIFORM(LineUniforms, width))
+//
+// Shader::setUniforms() checks the description against the linked
+// program's active uniforms once (name and type), caches the locations and
+// then only uploads the members whose value changed since the last upload.
+// Programs built from SPIR-V have no uniform names; there member i is
+// matched with the uniform at `layout (location = i)` instead.
+
+// one member: GLSL name, GL type and where it lives in the struct
+struct UniformField
+{
+  const char *name;
+  GLenum type;
+  size_t offset;
+  size_t size;
+};
+
+// GL type of a member's C++ type
+template<typename T> struct UniformType;
+template<> struct UniformType<int> { static constexpr GLenum value = GL_INT; };
+template<> struct UniformType<float> { static constexpr GLenum value = GL_FLOAT; };
+template<> struct UniformType<float[2]> { static constexpr GLenum value = GL_FLOAT_VEC2; };
+template<> struct UniformType<float[4]> { static constexpr GLenum value = GL_FLOAT_VEC4; };
+// column-major, like every matrix here
+template<> struct UniformType<float[16]> { static constexpr GLenum value = GL_FLOAT_MAT4; };
+
+// specialized by UNIFORM_INTERFACE
+template<typename T> struct UniformInterface;
+
+#define UNIFORM(Struct, member) \
+  UniformField{ #member, UniformType<decltype(Struct::member)>::value, offsetof(Struct, member), sizeof(Struct::member) }
+
+#define UNIFORM_INTERFACE(Struct, ...) \
+  template<> struct UniformInterface<Struct> { \
+    static constexpr const char *name = #Struct; \
+    static constexpr UniformField fields[] = { __VA_ARGS__ }; \
+  };
+
+// type erased interface, one instance per struct
+struct UniformLayout
+{
+  const char *name;
+  const UniformField *fields;
+  int count;
+  size_t size;
+};
+
+template<typename T> const UniformLayout& uniformLayout() {
+  // copied byte for byte into command lists and compared the same way
+  static_assert(std::is_trivially_copyable<T>::value && std::is_standard_layout<T>::value,
+                "uniform interfaces must be plain structs");
+  static_assert(sizeof(T) % 4 == 0, "uniform interfaces are made of 4 byte values");
+  static const UniformLayout layout = {
+    UniformInterface<T>::name, UniformInterface<T>::fields,
+    (int) (sizeof(UniformInterface<T>::fields) / sizeof(UniformField)), sizeof(T)
+  };
+  return layout;
+}
+
+#endif
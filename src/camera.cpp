@@ -0,0 +1,50 @@
+#include "camera.hpp"
+
+#include <algorithm>
+
+void Camera::resize(int w, int h) {
+  width = std::max(w, 1);
+  height = std::max(h, 1);
+  // the shorter side spans [-1,1], the longer one shows more of the map
+  aspect[0] = width > height ? (double) height / width : 1.0;
+  aspect[1] = height > width ? (double) width / height : 1.0;
+}
+
+void Camera::pan(double dx, double dy) {
+  center[0] -= 2.0 * dx / width / (zoom * aspect[0]);
+  center[1] += 2.0 * dy / height / (zoom * aspect[1]);
+}
+
+void Camera::zoomAt(double factor, double x, double y) {
+  double before[2], after[2];
+  toLayer(x, y, before[0], before[1]);
+  zoom = std::max(minZoom, std::min(maxZoom, zoom * factor));
+  toLayer(x, y, after[0], after[1]);
+  center[0] += before[0] - after[0];
+  center[1] += before[1] - after[1];
+}
+
+void Camera::reset() {
+  center[0] = center[1] = 0.0;
+  zoom = 1.0;
+}
+
+void Camera::toLayer(double x, double y, double &lx, double &ly) const {
+  double clipX = 2.0 * x / width - 1.0;
+  double clipY = 1.0 - 2.0 * y / height;
+  lx = center[0] + clipX / (zoom * aspect[0]);
+  ly = center[1] + clipY / (zoom * aspect[1]);
+}
+
+void Camera::viewMatrix(float *view) const {
+  // clip = (layer - center) * zoom * aspect
+  double sx = zoom * aspect[0];
+  double sy = zoom * aspect[1];
+  std::fill(view, view + 16, 0.0f);
+  view[0] = sx;
+  view[5] = sy;
+  view[10] = 1.0f;
+  view[12] = -center[0] * sx;
+  view[13] = -center[1] * sy;
+  view[15] = 1.0f;
+}
@@ -0,0 +1,483 @@
+#include "command_list.hpp"
+#include "gl_ext.hpp"
+#include "gl_state.hpp"
+#include "gpu_timer.hpp"
+#include "shader.hpp"
+
+#include <cstring>
+
+static float asFloat(int32_t word) {
+  float value;
+  memcpy(&value, &word, sizeof(value));
+  return value;
+}
+
+void CommandList::clear() {
+  words.clear();
+  shaders.clear();
+  timers.clear();
+  names.clear();
+  layouts.clear();
+}
+
+void CommandList::push(float value) {
+  int32_t word;
+  memcpy(&word, &value, sizeof(word));
+  words.push_back(word);
+}
+
+int32_t CommandList::intern(const std::string &name) {
+  // a handful of distinct uniform names per list, a scan beats hashing
+  for(size_t i = 0; i < names.size(); i++)
+    if(names[i] == name)
+      return i;
+  names.push_back(name);
+  return names.size() - 1;
+}
+
+void CommandList::clear(GLbitfield mask, float r, float g, float b, float a) {
+  words.push_back(CLEAR);
+  words.push_back(mask);
+  push(r);
+  push(g);
+  push(b);
+  push(a);
+}
+
+void CommandList::useProgram(Shader *shader) {
+  words.push_back(USE_PROGRAM);
+  words.push_back(shaders.size());
+  shaders.push_back(shader);
+}
+
+void CommandList::setInt(const std::string &name, int value) {
+  words.push_back(SET_INT);
+  words.push_back(intern(name));
+  words.push_back(value);
+}
+
+void CommandList::setFloat(const std::string &name, float value) {
+  words.push_back(SET_FLOAT);
+  words.push_back(intern(name));
+  push(value);
+}
+
+void CommandList::setVec2(const std::string &name, float x, float y) {
+  words.push_back(SET_VEC2);
+  words.push_back(intern(name));
+  push(x);
+  push(y);
+}
+
+void CommandList::setMat4(const std::string &name, const float *value) {
+  words.push_back(SET_MAT4);
+  words.push_back(intern(name));
+  for(int i = 0; i < 16; i++)
+    push(value[i]);
+}
+
+void CommandList::setUniforms(const UniformLayout &layout, const void *values) {
+  // the struct is copied as is, replay hands it to the shader in one piece
+  size_t count = layout.size / sizeof(int32_t);
+  words.push_back(SET_UNIFORMS);
+  words.push_back(layouts.size());
+  words.push_back(count);
+  layouts.push_back(&layout);
+  size_t at = words.size();
+  words.resize(at + count);
+  memcpy(&words[at], values, layout.size);
+}
+
+void CommandList::bindVertexArray(GLuint vao) {
+  words.push_back(BIND_VERTEX_ARRAY);
+  words.push_back(vao);
+}
+
+void CommandList::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+  words.push_back(BIND_TEXTURE);
+  words.push_back(unit);
+  words.push_back(target);
+  words.push_back(texture);
+}
+
+void CommandList::bindFramebuffer(GLuint fbo) {
+  words.push_back(BIND_FRAMEBUFFER);
+  words.push_back(fbo);
+}
+
+void CommandList::drawBuffers(GLbitfield attachments) {
+  words.push_back(DRAW_BUFFERS);
+  words.push_back(attachments);
+}
+
+void CommandList::clearBufferUint(GLint index, GLuint value) {
+  words.push_back(CLEAR_BUFFER_UINT);
+  words.push_back(index);
+  words.push_back(value);
+}
+
+void CommandList::logicOp(GLenum op) {
+  words.push_back(LOGIC_OP);
+  words.push_back(op);
+}
+
+void CommandList::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+  words.push_back(BIND_BUFFER_BASE);
+  words.push_back(target);
+  words.push_back(index);
+  words.push_back(buffer);
+}
+
+void CommandList::fillBuffer(GLuint buffer, GLuint value) {
+  words.push_back(FILL_BUFFER);
+  words.push_back(buffer);
+  words.push_back(value);
+}
+
+void CommandList::dispatchCompute(GLuint x, GLuint y, GLuint z) {
+  words.push_back(DISPATCH_COMPUTE);
+  words.push_back(x);
+  words.push_back(y);
+  words.push_back(z);
+}
+
+void CommandList::memoryBarrier(GLbitfield barriers) {
+  words.push_back(MEMORY_BARRIER);
+  words.push_back(barriers);
+}
+
+void CommandList::polygonMode(GLenum mode) {
+  words.push_back(POLYGON_MODE);
+  words.push_back(mode);
+}
+
+void CommandList::lineWidth(float width) {
+  words.push_back(LINE_WIDTH);
+  push(width);
+}
+
+void CommandList::blend(bool enabled) {
+  words.push_back(BLEND);
+  words.push_back(enabled);
+}
+
+void CommandList::blendFunc(GLenum sfactor, GLenum dfactor) {
+  words.push_back(BLEND_FUNC);
+  words.push_back(sfactor);
+  words.push_back(dfactor);
+}
+
+void CommandList::stencilTest(bool enabled) {
+  words.push_back(STENCIL_TEST);
+  words.push_back(enabled);
+}
+
+void CommandList::stencilFunc(GLenum func, GLint ref, GLuint mask) {
+  words.push_back(STENCIL_FUNC);
+  words.push_back(func);
+  words.push_back(ref);
+  words.push_back(mask);
+}
+
+void CommandList::stencilOp(GLenum face, GLenum sfail, GLenum dpfail, GLenum dppass) {
+  words.push_back(STENCIL_OP);
+  words.push_back(face);
+  words.push_back(sfail);
+  words.push_back(dpfail);
+  words.push_back(dppass);
+}
+
+void CommandList::colorMask(bool enabled) {
+  words.push_back(COLOR_MASK);
+  words.push_back(enabled);
+}
+
+void CommandList::drawArrays(GLenum mode, GLint first, GLsizei count) {
+  words.push_back(DRAW_ARRAYS);
+  words.push_back(mode);
+  words.push_back(first);
+  words.push_back(count);
+}
+
+void CommandList::drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+  if(instances <= 0)
+    return;
+  words.push_back(DRAW_ARRAYS_INSTANCED);
+  words.push_back(mode);
+  words.push_back(first);
+  words.push_back(count);
+  words.push_back(instances);
+}
+
+void CommandList::multiDrawArrays(GLenum mode, const GLint *first, const GLsizei *count, GLsizei drawCount) {
+  if(drawCount <= 0)
+    return;
+  words.push_back(MULTI_DRAW_ARRAYS);
+  words.push_back(mode);
+  words.push_back(drawCount);
+  words.insert(words.end(), first, first + drawCount);
+  words.insert(words.end(), count, count + drawCount);
+}
+
+void CommandList::multiDrawArraysIndirect(GLenum mode, GLuint commands, GLsizei maxDrawCount, GLuint countBuffer) {
+  if(maxDrawCount <= 0)
+    return;
+  words.push_back(MULTI_DRAW_ARRAYS_INDIRECT);
+  words.push_back(mode);
+  words.push_back(commands);
+  words.push_back(maxDrawCount);
+  words.push_back(countBuffer);
+}
+
+void CommandList::beginTimer(GPUTimers *t, const std::string &pass) {
+  words.push_back(BEGIN_TIMER);
+  words.push_back(timers.size());
+  words.push_back(intern(pass));
+  timers.push_back(t);
+}
+
+void CommandList::endTimer(GPUTimers *t) {
+  words.push_back(END_TIMER);
+  words.push_back(timers.size());
+  timers.push_back(t);
+}
+
+void CommandList::append(const CommandList &other) {
+  // indices into the pools are rebased while copying
+  size_t i = 0;
+  while(i < other.words.size()) {
+    int32_t op = other.words[i];
+    switch(op) {
+      case USE_PROGRAM:
+        useProgram(other.shaders[other.words[i + 1]]);
+        i += 2;
+        break;
+      case SET_INT:
+        setInt(other.names[other.words[i + 1]], other.words[i + 2]);
+        i += 3;
+        break;
+      case SET_FLOAT:
+        setFloat(other.names[other.words[i + 1]], asFloat(other.words[i + 2]));
+        i += 3;
+        break;
+      case SET_VEC2:
+        setVec2(other.names[other.words[i + 1]], asFloat(other.words[i + 2]), asFloat(other.words[i + 3]));
+        i += 4;
+        break;
+      case SET_MAT4: {
+        float value[16];
+        for(int k = 0; k < 16; k++)
+          value[k] = asFloat(other.words[i + 2 + k]);
+        setMat4(other.names[other.words[i + 1]], value);
+        i += 18;
+        break;
+      }
+      case SET_UNIFORMS:
+        setUniforms(*other.layouts[other.words[i + 1]], &other.words[i + 3]);
+        i += 3 + other.words[i + 2];
+        break;
+      case BEGIN_TIMER:
+        beginTimer(other.timers[other.words[i + 1]], other.names[other.words[i + 2]]);
+        i += 3;
+        break;
+      case END_TIMER:
+        endTimer(other.timers[other.words[i + 1]]);
+        i += 2;
+        break;
+      default: {
+        // everything else is position independent, copy it verbatim
+        size_t size = 0;
+        switch(op) {
+          case CLEAR: size = 6; break;
+          case BIND_VERTEX_ARRAY: case POLYGON_MODE: case LINE_WIDTH: case BLEND:
+          case STENCIL_TEST: case COLOR_MASK: case BIND_FRAMEBUFFER: case MEMORY_BARRIER:
+          case DRAW_BUFFERS: case LOGIC_OP: size = 2; break;
+          case BLEND_FUNC: case FILL_BUFFER: case CLEAR_BUFFER_UINT: size = 3; break;
+          case DRAW_ARRAYS: case STENCIL_FUNC: case BIND_TEXTURE: case BIND_BUFFER_BASE:
+          case DISPATCH_COMPUTE: size = 4; break;
+          case STENCIL_OP: case DRAW_ARRAYS_INSTANCED: case MULTI_DRAW_ARRAYS_INDIRECT: size = 5; break;
+          case MULTI_DRAW_ARRAYS: size = 3 + 2 * (size_t) other.words[i + 2]; break;
+        }
+        words.insert(words.end(), other.words.begin() + i, other.words.begin() + i + size);
+        i += size;
+      }
+    }
+  }
+}
+
+void CommandList::replay() const {
+  GLState &state = GLState::current();
+  Shader *shader = NULL;
+
+  size_t i = 0;
+  const int32_t *w = words.data();
+  while(i < words.size()) {
+    switch(w[i]) {
+      case CLEAR:
+        glClearColor(asFloat(w[i + 2]), asFloat(w[i + 3]), asFloat(w[i + 4]), asFloat(w[i + 5]));
+        glClear(w[i + 1]);
+        i += 6;
+        break;
+      case USE_PROGRAM:
+        shader = shaders[w[i + 1]];
+        shader->use();
+        i += 2;
+        break;
+      case SET_INT:
+        if(shader)
+          shader->setInt(names[w[i + 1]], w[i + 2]);
+        i += 3;
+        break;
+      case SET_FLOAT:
+        if(shader)
+          shader->setFloat(names[w[i + 1]], asFloat(w[i + 2]));
+        i += 3;
+        break;
+      case SET_VEC2:
+        if(shader)
+          shader->setVec2(names[w[i + 1]], asFloat(w[i + 2]), asFloat(w[i + 3]));
+        i += 4;
+        break;
+      case SET_MAT4:
+        if(shader)
+          shader->setMat4(names[w[i + 1]], (const float*) &w[i + 2]);
+        i += 18;
+        break;
+      case SET_UNIFORMS:
+        if(shader)
+          shader->setUniforms(*layouts[w[i + 1]], &w[i + 3]);
+        i += 3 + w[i + 2];
+        break;
+      case BIND_VERTEX_ARRAY:
+        state.bindVertexArray(w[i + 1]);
+        i += 2;
+        break;
+      case BIND_TEXTURE:
+        glActiveTexture(GL_TEXTURE0 + w[i + 1]);
+        glBindTexture(w[i + 2], w[i + 3]);
+        i += 4;
+        break;
+      case BIND_FRAMEBUFFER:
+        glBindFramebuffer(GL_FRAMEBUFFER, w[i + 1]);
+        i += 2;
+        break;
+      case DRAW_BUFFERS: {
+        GLenum buffers[8];
+        GLsizei count = 0;
+        for(GLuint bits = w[i + 1]; bits && count < 8; bits >>= 1, count++)
+          buffers[count] = bits & 1 ? GL_COLOR_ATTACHMENT0 + count : GL_NONE;
+        glDrawBuffers(count, buffers);
+        i += 2;
+        break;
+      }
+      case CLEAR_BUFFER_UINT: {
+        GLuint value[4] = { (GLuint) w[i + 2], 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, w[i + 1], value);
+        i += 3;
+        break;
+      }
+      case LOGIC_OP:
+        if(w[i + 1] == GL_COPY) {
+          glDisable(GL_COLOR_LOGIC_OP);
+        } else {
+          glEnable(GL_COLOR_LOGIC_OP);
+          glLogicOp(w[i + 1]);
+        }
+        i += 2;
+        break;
+      case BIND_BUFFER_BASE:
+        // also changes the generic binding point behind the cache's back
+        glBindBufferBase(w[i + 1], w[i + 2], w[i + 3]);
+        state.bindBuffer(w[i + 1], w[i + 3]);
+        i += 4;
+        break;
+      case FILL_BUFFER: {
+        GLuint value = w[i + 2];
+        state.bindBuffer(GL_COPY_WRITE_BUFFER, w[i + 1]);
+        glClearBufferData(GL_COPY_WRITE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &value);
+        i += 3;
+        break;
+      }
+      case DISPATCH_COMPUTE:
+        glDispatchCompute(w[i + 1], w[i + 2], w[i + 3]);
+        i += 4;
+        break;
+      case MEMORY_BARRIER:
+        glMemoryBarrier(w[i + 1]);
+        i += 2;
+        break;
+      case POLYGON_MODE:
+        state.polygonMode(w[i + 1]);
+        i += 2;
+        break;
+      case LINE_WIDTH:
+        state.lineWidth(asFloat(w[i + 1]));
+        i += 2;
+        break;
+      case BLEND:
+        state.blend(w[i + 1]);
+        i += 2;
+        break;
+      case BLEND_FUNC:
+        state.blendFunc(w[i + 1], w[i + 2]);
+        i += 3;
+        break;
+      case STENCIL_TEST:
+        state.stencilTest(w[i + 1]);
+        i += 2;
+        break;
+      case STENCIL_FUNC:
+        glStencilFunc(w[i + 1], w[i + 2], w[i + 3]);
+        i += 4;
+        break;
+      case STENCIL_OP:
+        glStencilOpSeparate(w[i + 1], w[i + 2], w[i + 3], w[i + 4]);
+        i += 5;
+        break;
+      case COLOR_MASK:
+        state.colorMask(w[i + 1]);
+        i += 2;
+        break;
+      case DRAW_ARRAYS:
+        glDrawArrays(w[i + 1], w[i + 2], w[i + 3]);
+        i += 4;
+        break;
+      case DRAW_ARRAYS_INSTANCED:
+        glDrawArraysInstanced(w[i + 1], w[i + 2], w[i + 3], w[i + 4]);
+        i += 5;
+        break;
+      case MULTI_DRAW_ARRAYS_INDIRECT:
+        state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, w[i + 2]);
+        if(w[i + 4] && GLEXT_indirect_count) {
+          state.bindBuffer(GL_PARAMETER_BUFFER, w[i + 4]);
+          glMultiDrawArraysIndirectCountAny(w[i + 1], NULL, 0, w[i + 3], 0);
+        } else {
+          glMultiDrawArraysIndirect(w[i + 1], NULL, w[i + 3], 0);
+        }
+        i += 5;
+        break;
+      case MULTI_DRAW_ARRAYS: {
+        GLsizei count = w[i + 2];
+        glMultiDrawArrays(w[i + 1], &w[i + 3], &w[i + 3 + count], count);
+        i += 3 + 2 * (size_t) count;
+        break;
+      }
+      case BEGIN_TIMER:
+        timers[w[i + 1]]->begin(names[w[i + 2]]);
+        i += 3;
+        break;
+      case END_TIMER:
+        timers[w[i + 1]]->end();
+        i += 2;
+        break;
+      default:
+        // corrupt stream, better to stop than to guess
+        return;
+    }
+  }
+}
+
+void CommandList::replay(const std::vector<CommandList> &lists) {
+  for(const CommandList &list : lists)
+    list.replay();
+}
@@ -0,0 +1,238 @@
+#include "context.hpp"
+#include "gl_ext.hpp"
+#include "gl_state.hpp"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstring>
+#include <iostream>
+
+// GL version requested from every backend (4.3: compute shaders)
+static const int GL_MAJOR = 4;
+static const int GL_MINOR = 3;
+
+bool Context::loadGL() {
+  if (!gladLoadGLLoader(loader()))
+  {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    return false;
+  }
+  loadGLExtensions(loader());
+  setupFramebuffer();
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// GLFW window
+// ---------------------------------------------------------------------------
+
+WindowContext::WindowContext(int width, int height, const char* title, WindowContext* share) : primary(share == NULL) {
+  glfwInit();
+
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, GL_MAJOR);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, GL_MINOR);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+#ifdef __APPLE__
+  //*MacOS specific to force CORE profile only
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+  // GLFW window creation
+  glfwWindowHint(GLFW_VISIBLE, primary);
+  window = glfwCreateWindow(width, height, title, NULL, share ? share->window : NULL);
+  glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+  if (window == NULL)
+  {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    if(primary)
+      glfwTerminate();
+    return;
+  }
+  // a shared context belongs to another thread
+  if(primary)
+    glfwMakeContextCurrent(window);
+}
+
+WindowContext::~WindowContext() {
+  // Delete all GLFW resources
+  if(window && primary)
+    glfwTerminate();
+  else if(window)
+    glfwDestroyWindow(window);
+}
+
+void WindowContext::makeCurrent() {
+  glfwMakeContextCurrent(window);
+  GLState::current().invalidate();
+}
+
+void WindowContext::doneCurrent() {
+  glfwMakeContextCurrent(NULL);
+}
+
+void WindowContext::size(int &width, int &height) const {
+  glfwGetFramebufferSize(window, &width, &height);
+}
+
+void WindowContext::present() {
+  glfwSwapBuffers(window);
+}
+
+GLADloadproc WindowContext::loader() const {
+  return (GLADloadproc) glfwGetProcAddress;
+}
+
+// ---------------------------------------------------------------------------
+// EGL offscreen
+// ---------------------------------------------------------------------------
+
+// every headless context shares one display, terminated with the last one
+static EGLDisplay sharedDisplay = EGL_NO_DISPLAY;
+static int displayUsers = 0;
+
+static EGLDisplay openDisplay() {
+  if(sharedDisplay != EGL_NO_DISPLAY) {
+    displayUsers++;
+    return sharedDisplay;
+  }
+
+  EGLDisplay display = EGL_NO_DISPLAY;
+  // surfaceless needs no X server, no GPU and no DRM node
+  const char *clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  if(clientExtensions && strstr(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay)
+      display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if(display == EGL_NO_DISPLAY)
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+  if(display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    std::cout << "Failed to initialize EGL display" << std::endl;
+    return EGL_NO_DISPLAY;
+  }
+  sharedDisplay = display;
+  displayUsers = 1;
+  return display;
+}
+
+static void closeDisplay() {
+  if(--displayUsers == 0) {
+    eglTerminate(sharedDisplay);
+    sharedDisplay = EGL_NO_DISPLAY;
+  }
+}
+
+HeadlessContext::HeadlessContext(int width, int height, HeadlessContext* share) : width(width), height(height) {
+  display = openDisplay();
+  if(display == EGL_NO_DISPLAY)
+    return;
+
+  if(!eglBindAPI(EGL_OPENGL_API)) {
+    std::cout << "EGL has no desktop OpenGL support" << std::endl;
+    return;
+  }
+
+  const EGLint configAttribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+    EGL_NONE
+  };
+  EGLConfig config = NULL;
+  EGLint configCount = 0;
+  eglChooseConfig(display, configAttribs, &config, 1, &configCount);
+
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  bool noConfig = extensions && strstr(extensions, "EGL_KHR_no_config_context");
+  bool surfaceless = extensions && strstr(extensions, "EGL_KHR_surfaceless_context");
+  if(configCount == 0) {
+    // surfaceless platforms may expose no pbuffer configs at all, fine as
+    // long as we can go without a config and a surface
+    if(!noConfig || !surfaceless) {
+      std::cout << "No usable EGL config for offscreen rendering" << std::endl;
+      return;
+    }
+    config = EGL_NO_CONFIG_KHR;
+  }
+
+  const EGLint contextAttribs[] = {
+    EGL_CONTEXT_MAJOR_VERSION, GL_MAJOR,
+    EGL_CONTEXT_MINOR_VERSION, GL_MINOR,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+    EGL_NONE
+  };
+  context = eglCreateContext(display, config, share ? share->context : EGL_NO_CONTEXT, contextAttribs);
+  if(context == EGL_NO_CONTEXT) {
+    std::cout << "Failed to create EGL context (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+    return;
+  }
+
+  // everything is drawn into our FBO, a surface is only needed to make
+  // the context current on drivers without surfaceless support
+  if(!surfaceless) {
+    const EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+    surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+  }
+  makeCurrent();
+}
+
+HeadlessContext::~HeadlessContext() {
+  if(display == EGL_NO_DISPLAY)
+    return;
+  if(context != EGL_NO_CONTEXT) {
+    makeCurrent();
+    if(fbo) {
+      glDeleteFramebuffers(1, &fbo);
+      glDeleteRenderbuffers(1, &colorBuffer);
+      glDeleteRenderbuffers(1, &depthStencilBuffer);
+    }
+    doneCurrent();
+    eglDestroyContext(display, context);
+  }
+  if(surface != EGL_NO_SURFACE)
+    eglDestroySurface(display, surface);
+  closeDisplay();
+}
+
+void HeadlessContext::makeCurrent() {
+  eglMakeCurrent(display, surface, surface, context);
+  GLState::current().invalidate();
+}
+
+void HeadlessContext::doneCurrent() {
+  eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+void HeadlessContext::present() {
+  // make sure the frame is complete before anyone reads it back
+  glFlush();
+}
+
+GLADloadproc HeadlessContext::loader() const {
+  return (GLADloadproc) eglGetProcAddress;
+}
+
+void HeadlessContext::setupFramebuffer() {
+  glGenRenderbuffers(1, &colorBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+  glGenRenderbuffers(1, &depthStencilBuffer);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthStencilBuffer);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencilBuffer);
+  if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "ERROR::FRAMEBUFFER:: offscreen framebuffer is not complete" << std::endl;
+
+  // stays bound: this context never draws anywhere else
+  glViewport(0, 0, width, height);
+}
@@ -0,0 +1,141 @@
+#include "flow_renderer.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const float IDENTITY[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+
+std::vector<ODPair> loadODPairs(const char* path, int zoneBase) {
+  std::vector<ODPair> pairs;
+  FILE *file = fopen(path, "r");
+  if(!file) {
+    std::cout << "ERROR::FLOWS::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+    return pairs;
+  }
+
+  char line[256];
+  while(fgets(line, sizeof(line), file)) {
+    // strtol/strtof instead of sscanf, this runs for millions of rows
+    char *p = line, *end;
+    ODPair pair;
+    pair.origin = strtol(p, &end, 10);
+    if(end == p)
+      continue;
+    p = end + strspn(end, ",; \t");
+    pair.destination = strtol(p, &end, 10);
+    if(end == p)
+      continue;
+    p = end + strspn(end, ",; \t");
+    pair.volume = strtof(p, &end);
+    if(end == p)
+      continue;
+    pair.origin -= zoneBase;
+    pair.destination -= zoneBase;
+    pairs.push_back(pair);
+  }
+  fclose(file);
+  std::cout << "READ " << pairs.size() << " OD PAIRS" << std::endl;
+  return pairs;
+}
+
+FlowRenderer::FlowRenderer(const Map &map, std::vector<ODPair> pairs) : zones(map.shapeCounts.size()) {
+  GLState &state = GLState::current();
+  std::copy(IDENTITY, IDENTITY + 16, view);
+
+  std::vector<float> centroids = shapeCentroids(map);
+  glGenBuffers(1, &centroidVBO);
+  state.bindBuffer(GL_TEXTURE_BUFFER, centroidVBO);
+  glBufferData(GL_TEXTURE_BUFFER, centroids.size()*sizeof(float), centroids.data(), GL_STATIC_DRAW);
+  state.bindBuffer(GL_TEXTURE_BUFFER, 0);
+  glGenTextures(1, &centroidTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, centroidTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, centroidVBO);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+  // per instance: ivec2 (origin, destination) and the volume
+  glGenBuffers(1, &pairVBO);
+  glGenVertexArrays(1, &VAO);
+  state.bindVertexArray(VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, pairVBO);
+  glVertexAttribIPointer(0, 2, GL_INT, sizeof(ODPair), (void*) offsetof(ODPair, origin));
+  glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(ODPair), (void*) offsetof(ODPair, volume));
+  glVertexAttribDivisor(0, 1);
+  glVertexAttribDivisor(1, 1);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  state.bindVertexArray(0);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+  setPairs(std::move(pairs));
+}
+
+void FlowRenderer::setPairs(std::vector<ODPair> pairs) {
+  GLState &state = GLState::current();
+
+  int zones = this->zones;
+  size_t dropped = pairs.size();
+  pairs.erase(std::remove_if(pairs.begin(), pairs.end(), [zones](const ODPair &p) {
+    return p.origin == p.destination || p.origin < 0 || p.origin >= zones ||
+           p.destination < 0 || p.destination >= zones || !(p.volume > 0);
+  }), pairs.end());
+  dropped -= pairs.size();
+  if(dropped)
+    std::cout << "Dropped " << dropped << " OD pairs (same zone, unknown zone or no volume)" << std::endl;
+
+  // small flows first, so the big ones end up on top
+  std::sort(pairs.begin(), pairs.end(), [](const ODPair &a, const ODPair &b) { return a.volume < b.volume; });
+  pairCount = pairs.size();
+  maxVolume = pairs.empty() ? 1.0f : pairs.back().volume;
+
+  // orphans the old storage, a draw still reading it is not waited on
+  state.bindBuffer(GL_ARRAY_BUFFER, pairVBO);
+  glBufferData(GL_ARRAY_BUFFER, pairs.size()*sizeof(ODPair), pairs.data(), GL_STATIC_DRAW);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+FlowRenderer::~FlowRenderer() {
+  GLState &state = GLState::current();
+  state.forgetVertexArray(VAO);
+  glDeleteVertexArrays(1, &VAO);
+  state.forgetBuffer(pairVBO);
+  state.forgetBuffer(centroidVBO);
+  unsigned int buffers[2] = { pairVBO, centroidVBO };
+  glDeleteBuffers(2, buffers);
+  glDeleteTextures(1, &centroidTexture);
+}
+
+void FlowRenderer::record(CommandList &list, Shader &shader) const {
+  if(pairCount == 0)
+    return;
+  if(timers)
+    list.beginTimer(timers, "flows");
+  list.blend(true);
+  list.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  FlowUniforms uniforms;
+  std::copy(view, view + 16, uniforms.view);
+  std::copy(viewport, viewport + 2, uniforms.viewport);
+  uniforms.segments = segments;
+  uniforms.curvature = curvature;
+  uniforms.widthRange[0] = minWidth;
+  uniforms.widthRange[1] = maxWidth;
+  uniforms.maxVolume = maxVolume;
+  list.useProgram(&shader);
+  list.setUniforms(uniforms);
+  list.bindTexture(0, GL_TEXTURE_BUFFER, centroidTexture);
+  list.bindVertexArray(VAO);
+  list.drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 2 * (segments + 1), pairCount);
+  list.blend(false);
+  if(timers)
+    list.endTimer(timers);
+}
+
+void FlowRenderer::draw(Shader &shader) {
+  frame.clear();
+  record(frame, shader);
+  frame.replay();
+}
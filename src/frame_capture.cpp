@@ -0,0 +1,231 @@
+#include "frame_capture.hpp"
+#include "gl_state.hpp"
+
+#include <cstring>
+#include <iostream>
+
+FrameCapture::FrameCapture() {
+  for(Slot &slot : slots)
+    glGenBuffers(1, &slot.pbo);
+  encoder = std::thread(&FrameCapture::encode, this);
+}
+
+FrameCapture::~FrameCapture() {
+  stop();
+  collect(SLOTS);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quit = true;
+  }
+  wakeup.notify_one();
+  encoder.join();
+
+  GLState &state = GLState::current();
+  for(Slot &slot : slots) {
+    state.forgetBuffer(slot.pbo);
+    glDeleteBuffers(1, &slot.pbo);
+  }
+}
+
+void FrameCapture::screenshot(const std::string &path) {
+  pendingShot = path;
+}
+
+bool FrameCapture::start(const std::string &target, int fps) {
+  stop();
+  this->fps = fps;
+  frames = dropped = 0;
+  streamWidth = streamHeight = 0;
+  headerQueued = false;
+  issued = 0;
+  pipe = false;
+  stream = NULL;
+  if(target.find('%') != std::string::npos) {
+    format = SEQUENCE_PNG;
+    pattern = target;
+  } else {
+    format = target.size() > 4 && target.substr(target.size() - 4) == ".y4m" ? STREAM_Y4M : STREAM_RAW;
+    if(target[0] == '|') {
+      stream = popen(target.c_str() + 1, "w");
+      pipe = true;
+    } else {
+      stream = fopen(target.c_str(), "wb");
+    }
+    if(!stream) {
+      std::cout << "ERROR::CAPTURE::could not open " << target << std::endl;
+      return false;
+    }
+  }
+  active = true;
+  std::cout << "Recording to " << target << std::endl;
+  return true;
+}
+
+void FrameCapture::stop() {
+  if(!active)
+    return;
+  // the frames still in the ring belong to this recording
+  collect(SLOTS);
+  active = false;
+  if(stream) {
+    Job job;
+    job.stream = stream;
+    job.pipe = pipe;
+    job.close = true;
+    queue(std::move(job));
+    stream = NULL;
+  }
+  std::cout << "Recorded " << frames << " frames (" << dropped << " dropped)" << std::endl;
+}
+
+void FrameCapture::capture(unsigned int framebuffer, int width, int height) {
+  collect(0);
+  if(!active && pendingShot.empty())
+    return;
+
+  // every slot in flight: the GPU is several frames behind, wait for the oldest
+  if(inFlight == SLOTS)
+    collect(1);
+
+  Slot &slot = slots[next];
+  slot.recorded = pendingShot.empty();
+  if(!pendingShot.empty()) {
+    slot.path = pendingShot;
+    pendingShot.clear();
+  } else if(format == SEQUENCE_PNG) {
+    char path[1024];
+    snprintf(path, sizeof(path), pattern.c_str(), (int) issued);
+    slot.path = path;
+  } else {
+    slot.path.clear();
+  }
+  if(slot.recorded)
+    issued++;
+  slot.width = width;
+  slot.height = height;
+
+  GLState &state = GLState::current();
+  state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  size_t bytes = (size_t) width * height * 4;
+  if(slot.bytes != bytes) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+    slot.bytes = bytes;
+  }
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glReadBuffer(framebuffer ? GL_COLOR_ATTACHMENT0 : GL_BACK);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  // into the bound pack buffer: returns as soon as the copy is queued
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  next = (next + 1) % SLOTS;
+  inFlight++;
+}
+
+void FrameCapture::collect(int wait) {
+  GLState &state = GLState::current();
+  while(inFlight > 0) {
+    Slot &slot = slots[(next - inFlight + SLOTS) % SLOTS];
+    bool block = wait > 0;
+    GLenum status = glClientWaitSync(slot.fence, block ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, block ? 1000000000ull : 0);
+    if(status == GL_TIMEOUT_EXPIRED && !block)
+      break;
+    wait--;
+    glDeleteSync(slot.fence);
+    slot.fence = 0;
+    inFlight--;
+
+    Job job;
+    job.path = slot.path;
+    if(job.path.empty()) {
+      // a stream cannot change size halfway
+      if(!streamWidth) {
+        streamWidth = slot.width;
+        streamHeight = slot.height;
+      }
+      if(!stream || slot.width != streamWidth || slot.height != streamHeight) {
+        dropped++;
+        continue;
+      }
+      job.stream = stream;
+      job.format = format;
+      job.fps = fps;
+      job.header = !headerQueued;
+    }
+    {
+      // full queue: drop the frame here instead of copying it
+      std::unique_lock<std::mutex> lock(mutex);
+      if(lossless)
+        room.wait(lock, [this] { return jobs.size() < maxQueued; });
+      if(jobs.size() >= maxQueued) {
+        dropped++;
+        continue;
+      }
+    }
+
+    job.image.width = slot.width;
+    job.image.height = slot.height;
+    job.image.pixels.resize(slot.bytes);
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.bytes, GL_MAP_READ_BIT);
+    if(pixels) {
+      memcpy(job.image.pixels.data(), pixels, slot.bytes);
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if(slot.recorded)
+      frames++;
+    if(job.stream)
+      headerQueued = true;
+    queue(std::move(job));
+  }
+}
+
+void FrameCapture::queue(Job job) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+  }
+  wakeup.notify_one();
+}
+
+void FrameCapture::encode() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true) {
+    wakeup.wait(lock, [this] { return quit || !jobs.empty(); });
+    if(jobs.empty())
+      return;
+    Job job = std::move(jobs.front());
+    jobs.pop_front();
+    room.notify_one();
+    lock.unlock();
+    write(job);
+    lock.lock();
+  }
+}
+
+void FrameCapture::write(Job &job) {
+  if(job.close) {
+    if(job.pipe)
+      pclose(job.stream);
+    else
+      fclose(job.stream);
+    return;
+  }
+  flipRows(job.image);
+  if(!job.path.empty()) {
+    writePNG(job.path, job.image);
+    return;
+  }
+  bool written = true;
+  if(job.format == STREAM_Y4M) {
+    if(job.header)
+      written = writeY4MHeader(job.stream, job.image.width, job.image.height, job.fps);
+    written = written && writeY4MFrame(job.stream, job.image);
+  } else {
+    written = writeRawFrame(job.stream, job.image);
+  }
+  if(!written)
+    std::cout << "ERROR::CAPTURE::stream write failed" << std::endl;
+}
@@ -0,0 +1,50 @@
+#include "gl_ext.hpp"
+
+#include <cstring>
+#include <iostream>
+
+int GLEXT_parallel_shader_compile = 0;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glMaxShaderCompilerThreadsKHR = NULL;
+int GLEXT_indirect_count = 0;
+PFNGLMULTIDRAWARRAYSINDIRECTCOUNTPROC glMultiDrawArraysIndirectCountAny = NULL;
+int GLEXT_gl_spirv = 0;
+PFNGLSPECIALIZESHADERPROC glSpecializeShaderAny = NULL;
+
+bool hasGLExtension(const char *name) {
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for(GLint i = 0; i < count; i++) {
+    const char *ext = (const char*) glGetStringi(GL_EXTENSIONS, i);
+    if(ext && strcmp(ext, name) == 0)
+      return true;
+  }
+  return false;
+}
+
+void loadGLExtensions(GLADloadproc load) {
+  // KHR and ARB variants share enums and semantics
+  if(hasGLExtension("GL_KHR_parallel_shader_compile"))
+    glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) load("glMaxShaderCompilerThreadsKHR");
+  else if(hasGLExtension("GL_ARB_parallel_shader_compile"))
+    glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC) load("glMaxShaderCompilerThreadsARB");
+  GLEXT_parallel_shader_compile = glMaxShaderCompilerThreadsKHR != NULL;
+
+  if(GLEXT_parallel_shader_compile) {
+    // let the driver pick as many compiler threads as it wants
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    std::cout << "[I] parallel shader compile enabled" << std::endl;
+  }
+
+  // same signature in core and in the ARB extension
+  if(GLAD_GL_VERSION_4_6)
+    glMultiDrawArraysIndirectCountAny = glad_glMultiDrawArraysIndirectCount;
+  else if(hasGLExtension("GL_ARB_indirect_parameters"))
+    glMultiDrawArraysIndirectCountAny = (PFNGLMULTIDRAWARRAYSINDIRECTCOUNTPROC) load("glMultiDrawArraysIndirectCountARB");
+  GLEXT_indirect_count = glMultiDrawArraysIndirectCountAny != NULL;
+
+  if(GLAD_GL_VERSION_4_6)
+    glSpecializeShaderAny = glad_glSpecializeShader;
+  else if(hasGLExtension("GL_ARB_gl_spirv"))
+    glSpecializeShaderAny = (PFNGLSPECIALIZESHADERPROC) load("glSpecializeShaderARB");
+  GLEXT_gl_spirv = glSpecializeShaderAny != NULL;
+}
@@ -0,0 +1,162 @@
+#include "gl_state.hpp"
+
+static const char *CALL_NAMES[GLState::CALL_COUNT] = {
+  "glUseProgram", "glBindVertexArray", "glBindBuffer", "glPolygonMode",
+  "glLineWidth", "glEnable/glDisable(GL_BLEND)", "glBlendFunc",
+  "glEnable/glDisable(GL_STENCIL_TEST)", "glColorMask"
+};
+
+GLState::GLState() {
+  resetCounters();
+  invalidate();
+}
+
+GLState& GLState::current() {
+  // each thread owns at most one current context (windowed or tile workers)
+  thread_local GLState state;
+  return state;
+}
+
+void GLState::invalidate() {
+  program = UNKNOWN;
+  vertexArray = UNKNOWN;
+  for(int i = 0; i < BUFFER_TARGETS; i++) {
+    bufferTarget[i] = 0;
+    buffer[i] = UNKNOWN;
+  }
+  mode = 0;
+  width = -1.0f;
+  blending = -1;
+  blendSrc = blendDst = 0;
+  stencil = -1;
+  colorWrites = -1;
+}
+
+void GLState::resetCounters() {
+  for(int i = 0; i < CALL_COUNT; i++)
+    issued[i] = skipped[i] = 0;
+}
+
+bool GLState::changed(Call call, bool differs) {
+  if(differs)
+    issued[call]++;
+  else
+    skipped[call]++;
+  return differs;
+}
+
+GLuint* GLState::bufferSlot(GLenum target) {
+  for(int i = 0; i < BUFFER_TARGETS; i++) {
+    if(bufferTarget[i] == target)
+      return &buffer[i];
+    if(bufferTarget[i] == 0) {
+      bufferTarget[i] = target;
+      return &buffer[i];
+    }
+  }
+  return NULL;
+}
+
+void GLState::useProgram(GLuint id) {
+  if(changed(PROGRAM, program != id)) {
+    program = id;
+    glUseProgram(id);
+  }
+}
+
+void GLState::bindVertexArray(GLuint vao) {
+  if(changed(VERTEX_ARRAY, vertexArray != vao)) {
+    vertexArray = vao;
+    glBindVertexArray(vao);
+    // the element array binding is part of the VAO
+    GLuint *slot = bufferSlot(GL_ELEMENT_ARRAY_BUFFER);
+    if(slot)
+      *slot = UNKNOWN;
+  }
+}
+
+void GLState::bindBuffer(GLenum target, GLuint id) {
+  GLuint *slot = bufferSlot(target);
+  if(!slot) {
+    issued[BUFFER]++;
+    glBindBuffer(target, id);
+    return;
+  }
+  if(changed(BUFFER, *slot != id)) {
+    *slot = id;
+    glBindBuffer(target, id);
+  }
+}
+
+void GLState::polygonMode(GLenum m) {
+  if(changed(POLYGON_MODE, mode != m)) {
+    mode = m;
+    glPolygonMode(GL_FRONT_AND_BACK, m);
+  }
+}
+
+void GLState::lineWidth(GLfloat w) {
+  if(changed(LINE_WIDTH, width != w)) {
+    width = w;
+    glLineWidth(w);
+  }
+}
+
+void GLState::blend(bool enabled) {
+  if(changed(BLEND, blending != (int) enabled)) {
+    blending = enabled;
+    if(enabled)
+      glEnable(GL_BLEND);
+    else
+      glDisable(GL_BLEND);
+  }
+}
+
+void GLState::blendFunc(GLenum sfactor, GLenum dfactor) {
+  if(changed(BLEND_FUNC, blendSrc != sfactor || blendDst != dfactor)) {
+    blendSrc = sfactor;
+    blendDst = dfactor;
+    glBlendFunc(sfactor, dfactor);
+  }
+}
+
+void GLState::stencilTest(bool enabled) {
+  if(changed(STENCIL_TEST, stencil != (int) enabled)) {
+    stencil = enabled;
+    if(enabled)
+      glEnable(GL_STENCIL_TEST);
+    else
+      glDisable(GL_STENCIL_TEST);
+  }
+}
+
+void GLState::colorMask(bool enabled) {
+  if(changed(COLOR_MASK, colorWrites != (int) enabled)) {
+    colorWrites = enabled;
+    glColorMask(enabled, enabled, enabled, enabled);
+  }
+}
+
+void GLState::forgetProgram(GLuint id) {
+  if(program == id)
+    program = UNKNOWN;
+}
+
+void GLState::forgetBuffer(GLuint id) {
+  for(int i = 0; i < BUFFER_TARGETS; i++)
+    if(buffer[i] == id)
+      buffer[i] = UNKNOWN;
+}
+
+void GLState::forgetVertexArray(GLuint vao) {
+  if(vertexArray == vao)
+    vertexArray = UNKNOWN;
+}
+
+void GLState::report(std::ostream &out) const {
+  for(int i = 0; i < CALL_COUNT; i++) {
+    if(issued[i] + skipped[i] == 0)
+      continue;
+    out << CALL_NAMES[i] << ": " << issued[i] << " issued, " << skipped[i] << " skipped" << std::endl;
+  }
+}
@@ -0,0 +1,119 @@
+#include "gpu_timer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+GPUTimers::GPUTimers(int latency, size_t history) : frames(std::max(latency, 1) + 1), history(history) {
+}
+
+GPUTimers::~GPUTimers() {
+  for(std::vector<Pending> &frame : frames)
+    for(const Pending &p : frame) {
+      freeQueries.push_back(p.start);
+      freeQueries.push_back(p.end);
+    }
+  if(!freeQueries.empty())
+    glDeleteQueries(freeQueries.size(), freeQueries.data());
+}
+
+int GPUTimers::passIndex(const std::string &pass) {
+  for(size_t i = 0; i < passes.size(); i++)
+    if(passes[i] == pass)
+      return i;
+  passes.push_back(pass);
+  samples.push_back(std::vector<double>());
+  cursor.push_back(0);
+  return passes.size() - 1;
+}
+
+GLuint GPUTimers::query() {
+  if(freeQueries.empty()) {
+    // grow in batches, steady state allocates nothing
+    GLuint ids[16];
+    glGenQueries(16, ids);
+    freeQueries.insert(freeQueries.end(), ids, ids + 16);
+  }
+  GLuint id = freeQueries.back();
+  freeQueries.pop_back();
+  return id;
+}
+
+void GPUTimers::begin(const std::string &pass) {
+  Pending p;
+  p.pass = passIndex(pass);
+  p.start = query();
+  p.end = 0;
+  glQueryCounter(p.start, GL_TIMESTAMP);
+  open.push_back(frames[current].size());
+  frames[current].push_back(p);
+}
+
+void GPUTimers::end() {
+  if(open.empty())
+    return;
+  Pending &p = frames[current][open.back()];
+  open.pop_back();
+  p.end = query();
+  glQueryCounter(p.end, GL_TIMESTAMP);
+}
+
+void GPUTimers::collect(std::vector<Pending> &frame) {
+  for(const Pending &p : frame) {
+    GLint available = 0;
+    if(p.end)
+      glGetQueryObjectiv(p.end, GL_QUERY_RESULT_AVAILABLE, &available);
+    if(available) {
+      GLuint64 start, end;
+      glGetQueryObjectui64v(p.start, GL_QUERY_RESULT, &start);
+      glGetQueryObjectui64v(p.end, GL_QUERY_RESULT, &end);
+
+      std::vector<double> &ring = samples[p.pass];
+      double ms = (end - start) / 1e6;
+      if(ring.size() < history)
+        ring.push_back(ms);
+      else
+        ring[cursor[p.pass]++ % history] = ms;
+    }
+    freeQueries.push_back(p.start);
+    if(p.end)
+      freeQueries.push_back(p.end);
+  }
+  frame.clear();
+}
+
+void GPUTimers::endFrame() {
+  // unbalanced begin() calls are closed here so the ring stays consistent
+  while(!open.empty())
+    end();
+  current = (current + 1) % frames.size();
+  // the slot we are about to reuse was recorded `latency` frames ago
+  collect(frames[current]);
+}
+
+GPUTimers::Stats GPUTimers::stats(const std::string &pass) const {
+  Stats s;
+  for(size_t i = 0; i < passes.size(); i++) {
+    if(passes[i] != pass || samples[i].empty())
+      continue;
+    std::vector<double> sorted = samples[i];
+    std::sort(sorted.begin(), sorted.end());
+    s.samples = sorted.size();
+    s.minMs = sorted.front();
+    double sum = 0;
+    for(double ms : sorted)
+      sum += ms;
+    s.avgMs = sum / sorted.size();
+    s.p99Ms = sorted[std::min(sorted.size() - 1, (size_t) (0.99 * sorted.size()))];
+  }
+  return s;
+}
+
+void GPUTimers::report(std::ostream &out) const {
+  for(const std::string &pass : passes) {
+    Stats s = stats(pass);
+    char line[160];
+    snprintf(line, sizeof(line), "%-12s min %7.3f ms  avg %7.3f ms  p99 %7.3f ms  (%zu frames)",
+             pass.c_str(), s.minMs, s.avgMs, s.p99Ms, s.samples);
+    out << line << std::endl;
+  }
+}
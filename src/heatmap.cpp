@@ -0,0 +1,163 @@
+#include "heatmap.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+static const float IDENTITY[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+// texels per reduce workgroup side: 16x16 threads, 4x4 texels each
+static const int REDUCE_TILE = 64;
+
+HeatmapRenderer::HeatmapRenderer() {
+  GLState &state = GLState::current();
+  std::copy(IDENTITY, IDENTITY + 16, view);
+
+  // per instance: vec3 (x, y, weight)
+  glGenBuffers(1, &pointVBO);
+  glGenVertexArrays(1, &VAO);
+  state.bindVertexArray(VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, pointVBO);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), NULL);
+  glVertexAttribDivisor(0, 1);
+  glEnableVertexAttribArray(0);
+  state.bindVertexArray(0);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+  // the fullscreen pass reads no attributes
+  glGenVertexArrays(1, &emptyVAO);
+
+  glGenBuffers(1, &maxBuffer);
+  state.bindBuffer(GL_SHADER_STORAGE_BUFFER, maxBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+  state.bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glGenFramebuffers(1, &fbo);
+  glGenTextures(1, &density);
+  resize(viewport[0], viewport[1]);
+}
+
+HeatmapRenderer::~HeatmapRenderer() {
+  GLState &state = GLState::current();
+  state.forgetVertexArray(VAO);
+  state.forgetVertexArray(emptyVAO);
+  unsigned int vaos[2] = { VAO, emptyVAO };
+  glDeleteVertexArrays(2, vaos);
+  state.forgetBuffer(pointVBO);
+  state.forgetBuffer(maxBuffer);
+  unsigned int buffers[2] = { pointVBO, maxBuffer };
+  glDeleteBuffers(2, buffers);
+  glDeleteFramebuffers(1, &fbo);
+  glDeleteTextures(1, &density);
+}
+
+void HeatmapRenderer::setPoints(const std::vector<float> &points) {
+  GLState &state = GLState::current();
+  pointCount = points.size() / 3;
+  state.bindBuffer(GL_ARRAY_BUFFER, pointVBO);
+  glBufferData(GL_ARRAY_BUFFER, points.size()*sizeof(float), points.data(), GL_STATIC_DRAW);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void HeatmapRenderer::resize(int w, int h) {
+  w = std::max(w, 1);
+  h = std::max(h, 1);
+  viewport[0] = w;
+  viewport[1] = h;
+  if(w == width && h == height)
+    return;
+  width = w;
+  height = h;
+
+  GLint previous;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+  glBindTexture(GL_TEXTURE_2D, density);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, density, 0);
+  if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "ERROR::HEATMAP::FRAMEBUFFER_INCOMPLETE" << std::endl;
+  glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void HeatmapRenderer::record(CommandList &list, Shader &splat, Shader &reduce, Shader &color) const {
+  if(pointCount == 0)
+    return;
+  if(timers)
+    list.beginTimer(timers, "heatmap");
+
+  // 1. splat
+  list.bindFramebuffer(fbo);
+  list.clear(GL_COLOR_BUFFER_BIT, 0.0f, 0.0f, 0.0f, 0.0f);
+  list.blend(true);
+  list.blendFunc(GL_ONE, GL_ONE);
+  SplatUniforms uniforms;
+  std::copy(view, view + 16, uniforms.view);
+  std::copy(viewport, viewport + 2, uniforms.viewport);
+  uniforms.radius = radius;
+  list.useProgram(&splat);
+  list.setUniforms(uniforms);
+  list.bindVertexArray(VAO);
+  list.drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, pointCount);
+  list.bindFramebuffer(targetFramebuffer);
+
+  // 2. reduce
+  list.fillBuffer(maxBuffer, 0);
+  list.useProgram(&reduce);
+  list.bindTexture(0, GL_TEXTURE_2D, density);
+  list.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, maxBuffer);
+  list.dispatchCompute((width + REDUCE_TILE - 1) / REDUCE_TILE, (height + REDUCE_TILE - 1) / REDUCE_TILE, 1);
+  list.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  // 3. color
+  list.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  list.useProgram(&color);
+  list.bindVertexArray(emptyVAO);
+  list.drawArrays(GL_TRIANGLES, 0, 3);
+  list.blend(false);
+
+  if(timers)
+    list.endTimer(timers);
+}
+
+void HeatmapRenderer::draw(Shader &splat, Shader &reduce, Shader &color) {
+  frame.clear();
+  record(frame, splat, reduce, color);
+  frame.replay();
+}
+
+std::vector<float> loadPoints(const char* path, const Map &map) {
+  std::vector<float> points;
+  FILE *file = fopen(path, "r");
+  if(!file) {
+    std::cout << "ERROR::HEATMAP::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+    return points;
+  }
+  char line[256];
+  while(fgets(line, sizeof(line), file)) {
+    char *p = line, *end;
+    double x = strtod(p, &end);
+    if(end == p)
+      continue;
+    p = end + strspn(end, ",; \t");
+    double y = strtod(p, &end);
+    if(end == p)
+      continue;
+    p = end + strspn(end, ",; \t");
+    float weight = strtof(p, &end);
+    if(end == p)
+      weight = 1.0f;
+    float nx, ny;
+    normalizePoint(map, x, y, nx, ny);
+    points.push_back(nx);
+    points.push_back(ny);
+    points.push_back(weight);
+  }
+  fclose(file);
+  std::cout << "READ " << points.size() / 3 << " POINTS" << std::endl;
+  return points;
+}
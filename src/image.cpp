@@ -0,0 +1,126 @@
+#include "image.hpp"
+
+#include <png.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+Image readFramebuffer(unsigned int framebuffer, int width, int height) {
+  Image image;
+  image.width = width;
+  image.height = height;
+  image.pixels.resize((size_t) width * height * 4);
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+
+  // GL hands rows bottom-up, images are stored top-down
+  flipRows(image);
+  return image;
+}
+
+void flipRows(Image &image) {
+  size_t stride = (size_t) image.width * 4;
+  std::vector<unsigned char> row(stride);
+  for(int y = 0; y < image.height / 2; y++) {
+    unsigned char *top = &image.pixels[y * stride];
+    unsigned char *bottom = &image.pixels[(image.height - 1 - y) * stride];
+    memcpy(row.data(), top, stride);
+    memcpy(top, bottom, stride);
+    memcpy(bottom, row.data(), stride);
+  }
+}
+
+bool writePNG(const std::string &path, const Image &image) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if(!file) {
+    std::cout << "ERROR::IMAGE::could not open " << path << std::endl;
+    return false;
+  }
+
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info = png ? png_create_info_struct(png) : NULL;
+  if(!info || setjmp(png_jmpbuf(png))) {
+    std::cout << "ERROR::IMAGE::failed writing " << path << std::endl;
+    png_destroy_write_struct(&png, &info);
+    fclose(file);
+    return false;
+  }
+
+  png_init_io(png, file);
+  // batch jobs write thousands of these, favour speed over size
+  png_set_compression_level(png, 1);
+  png_set_IHDR(png, info, image.width, image.height, 8, PNG_COLOR_TYPE_RGBA,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+
+  size_t stride = (size_t) image.width * 4;
+  for(int y = 0; y < image.height; y++)
+    png_write_row(png, (png_const_bytep) &image.pixels[y * stride]);
+  png_write_end(png, NULL);
+
+  png_destroy_write_struct(&png, &info);
+  fclose(file);
+  return true;
+}
+
+bool writeRaw(const std::string &path, const Image &image) {
+  FILE *file = fopen(path.c_str(), "wb");
+  if(!file) {
+    std::cout << "ERROR::IMAGE::could not open " << path << std::endl;
+    return false;
+  }
+  bool written = writeRawFrame(file, image);
+  fclose(file);
+  return written;
+}
+
+bool writeRawFrame(FILE *file, const Image &image) {
+  return fwrite(image.pixels.data(), 1, image.pixels.size(), file) == image.pixels.size();
+}
+
+bool writeY4MHeader(FILE *file, int width, int height, int fps) {
+  return fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, fps) > 0;
+}
+
+bool writeY4MFrame(FILE *file, const Image &image) {
+  int w = image.width, h = image.height;
+  int cw = (w + 1) / 2, ch = (h + 1) / 2;
+  std::vector<unsigned char> planes((size_t) w * h + 2 * (size_t) cw * ch);
+  unsigned char *Y = planes.data(), *U = Y + (size_t) w * h, *V = U + (size_t) cw * ch;
+  const unsigned char *p = image.pixels.data();
+  for(int y = 0; y < h; y++)
+    for(int x = 0; x < w; x++) {
+      const unsigned char *c = p + 4 * ((size_t) y * w + x);
+      Y[(size_t) y * w + x] = 0.299f * c[0] + 0.587f * c[1] + 0.114f * c[2] + 0.5f;
+    }
+  // chroma of each 2x2 block, from its average color
+  for(int y = 0; y < ch; y++)
+    for(int x = 0; x < cw; x++) {
+      float r = 0, g = 0, b = 0;
+      int n = 0;
+      for(int dy = 0; dy < 2 && 2 * y + dy < h; dy++)
+        for(int dx = 0; dx < 2 && 2 * x + dx < w; dx++, n++) {
+          const unsigned char *c = p + 4 * ((size_t) (2 * y + dy) * w + 2 * x + dx);
+          r += c[0];
+          g += c[1];
+          b += c[2];
+        }
+      r /= n;
+      g /= n;
+      b /= n;
+      U[(size_t) y * cw + x] = std::min(255.0f, std::max(0.0f, 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b + 0.5f));
+      V[(size_t) y * cw + x] = std::min(255.0f, std::max(0.0f, 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b + 0.5f));
+    }
+  return fputs("FRAME\n", file) >= 0 && fwrite(planes.data(), 1, planes.size(), file) == planes.size();
+}
+
+bool writeImage(const std::string &path, const Image &image) {
+  size_t dot = path.rfind('.');
+  if(dot != std::string::npos && path.substr(dot) == ".png")
+    return writePNG(path, image);
+  return writeRaw(path, image);
+}
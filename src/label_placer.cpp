@@ -0,0 +1,181 @@
+#include "label_placer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+// grid cell side in pixels, about a short label
+static const float CELL = 64.0f;
+// power of two, cells far apart may share a bucket, that only costs a test
+static const int BUCKETS = 4096;
+
+void LabelPlacer::setLabels(const std::vector<float> &anchors, const std::vector<float> &sizes,
+                            const std::vector<float> &priority) {
+  this->anchors = anchors;
+  this->sizes = sizes;
+  size_t n = anchors.size() / 2;
+  order.resize(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&priority](int a, int b) { return priority[a] > priority[b]; });
+  rank.resize(n);
+  for(size_t i = 0; i < n; i++)
+    rank[order[i]] = i;
+  boxes.resize(n);
+  inView.assign(n, 0);
+  visible.assign(n, 0);
+  queued.assign(n, 0);
+  candidates.resize(BUCKETS);
+  shown.resize(BUCKETS);
+  placedCount = 0;
+  valid = false;
+}
+
+bool LabelPlacer::overlaps(const Box &a, const Box &b) const {
+  return a.x0 < b.x1 + margin && b.x0 < a.x1 + margin && a.y0 < b.y1 + margin && b.y0 < a.y1 + margin;
+}
+
+std::vector<int>& LabelPlacer::bucket(std::vector<std::vector<int>> &grid, int cx, int cy) {
+  unsigned int h = (unsigned int) cx * 73856093u ^ (unsigned int) cy * 19349663u;
+  return grid[h & (BUCKETS - 1)];
+}
+
+void LabelPlacer::insert(std::vector<std::vector<int>> &grid, int label) {
+  const Box &b = boxes[label];
+  for(int cy = std::floor(b.y0 / CELL); cy <= std::floor(b.y1 / CELL); cy++)
+    for(int cx = std::floor(b.x0 / CELL); cx <= std::floor(b.x1 / CELL); cx++)
+      bucket(grid, cx, cy).push_back(label);
+}
+
+void LabelPlacer::remove(std::vector<std::vector<int>> &grid, int label) {
+  const Box &b = boxes[label];
+  for(int cy = std::floor(b.y0 / CELL); cy <= std::floor(b.y1 / CELL); cy++)
+    for(int cx = std::floor(b.x0 / CELL); cx <= std::floor(b.x1 / CELL); cx++) {
+      std::vector<int> &cell = bucket(grid, cx, cy);
+      std::vector<int>::iterator it = std::find(cell.begin(), cell.end(), label);
+      if(it != cell.end()) {
+        *it = cell.back();
+        cell.pop_back();
+      }
+    }
+}
+
+bool LabelPlacer::blocked(int label) {
+  const Box &b = boxes[label];
+  for(int cy = std::floor((b.y0 - margin) / CELL); cy <= std::floor((b.y1 + margin) / CELL); cy++)
+    for(int cx = std::floor((b.x0 - margin) / CELL); cx <= std::floor((b.x1 + margin) / CELL); cx++)
+      for(int other : bucket(shown, cx, cy))
+        if(rank[other] < rank[label] && overlaps(b, boxes[other]))
+          return true;
+  return false;
+}
+
+void LabelPlacer::queue(int label) {
+  if(queued[label])
+    return;
+  queued[label] = 1;
+  heap.push_back(label);
+  std::push_heap(heap.begin(), heap.end(), [this](int a, int b) { return rank[a] > rank[b]; });
+}
+
+void LabelPlacer::queueBelow(int label, const Box &b) {
+  for(int cy = std::floor((b.y0 - margin) / CELL); cy <= std::floor((b.y1 + margin) / CELL); cy++)
+    for(int cx = std::floor((b.x0 - margin) / CELL); cx <= std::floor((b.x1 + margin) / CELL); cx++)
+      for(int other : bucket(candidates, cx, cy))
+        if(rank[other] > rank[label] && overlaps(b, boxes[other]))
+          queue(other);
+}
+
+void LabelPlacer::placeAll(const Box &region) {
+  for(std::vector<int> &cell : candidates)
+    cell.clear();
+  for(std::vector<int> &cell : shown)
+    cell.clear();
+  heap.clear();
+  std::fill(queued.begin(), queued.end(), 0);
+  std::fill(visible.begin(), visible.end(), 0);
+  placedCount = 0;
+  for(size_t i = 0; i < boxes.size(); i++) {
+    inView[i] = overlaps(boxes[i], region);
+    if(inView[i])
+      insert(candidates, i);
+  }
+  // in priority order every label above has already been decided
+  for(int label : order)
+    if(inView[label] && !blocked(label)) {
+      visible[label] = 1;
+      placedCount++;
+      insert(shown, label);
+    }
+}
+
+bool LabelPlacer::place(const float *view, const float *viewport) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  float halfWidth = viewport[0] * 0.5f, halfHeight = viewport[1] * 0.5f;
+  // pixels relative to the view's translation: screen = position + offset
+  float offsetX = (view[12] + 1.0f) * halfWidth, offsetY = (view[13] + 1.0f) * halfHeight;
+  Box region = { -offsetX, -offsetY, viewport[0] - offsetX, viewport[1] - offsetY };
+
+  float current[6] = { view[0], view[1], view[4], view[5], viewport[0], viewport[1] };
+  bool changed = false;
+  if(!valid || memcmp(current, scale, sizeof(scale)) != 0) {
+    // zoom or resize: every label moved
+    std::copy(current, current + 6, scale);
+    valid = true;
+    for(size_t i = 0; i < boxes.size(); i++) {
+      float x = anchors[2*i], y = anchors[2*i+1];
+      float px = (view[0] * x + view[4] * y) * halfWidth;
+      float py = (view[1] * x + view[5] * y) * halfHeight;
+      float w = sizes[2*i] * 0.5f, h = sizes[2*i+1] * 0.5f;
+      boxes[i] = { px - w, py - h, px + w, py + h };
+    }
+    placeAll(region);
+    changed = true;
+  } else {
+    // pan: only the labels crossing the viewport's edges
+    for(size_t i = 0; i < boxes.size(); i++) {
+      bool in = overlaps(boxes[i], region);
+      if(in == (bool) inView[i])
+        continue;
+      inView[i] = in;
+      if(in) {
+        insert(candidates, i);
+        queue(i);
+        continue;
+      }
+      if(visible[i]) {
+        visible[i] = 0;
+        placedCount--;
+        changed = true;
+        remove(shown, i);
+        queueBelow(i, boxes[i]);
+      }
+      remove(candidates, i);
+    }
+    // the queue pops by priority, so a label is decided after all of the
+    // labels above it that could still change
+    while(!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), [this](int a, int b) { return rank[a] > rank[b]; });
+      int label = heap.back();
+      heap.pop_back();
+      queued[label] = 0;
+      if(!inView[label])
+        continue;
+      unsigned char show = !blocked(label);
+      if(show == visible[label])
+        continue;
+      visible[label] = show;
+      placedCount += show ? 1 : -1;
+      if(show)
+        insert(shown, label);
+      else
+        remove(shown, label);
+      changed = true;
+      queueBelow(label, boxes[label]);
+    }
+  }
+  if(changed)
+    lastMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return changed;
+}
@@ -0,0 +1,142 @@
+#include "label_renderer.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+static const float IDENTITY[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+
+LabelRenderer::LabelRenderer() : atlas(buildGlyphAtlas()) {
+  GLState &state = GLState::current();
+  std::copy(IDENTITY, IDENTITY + 16, view);
+
+  // distances average well enough for mipmaps, small labels would alias
+  // without them (a few atlas texels per pixel)
+  glGenTextures(1, &atlasTexture);
+  glBindTexture(GL_TEXTURE_2D, atlasTexture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas.width, atlas.height, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.pixels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glGenerateMipmap(GL_TEXTURE_2D);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  // only the metrics are needed from now on
+  std::vector<unsigned char>().swap(atlas.pixels);
+
+  glGenBuffers(1, &glyphVBO);
+  glGenVertexArrays(1, &VAO);
+  state.bindVertexArray(VAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, glyphVBO);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Glyph), (void*) offsetof(Glyph, anchor));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Glyph), (void*) offsetof(Glyph, offset));
+  glVertexAttribIPointer(2, 2, GL_INT, sizeof(Glyph), (void*) offsetof(Glyph, cell));
+  for(int i = 0; i < 3; i++) {
+    glVertexAttribDivisor(i, 1);
+    glEnableVertexAttribArray(i);
+  }
+  state.bindVertexArray(0);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glGenBuffers(1, &visibleVBO);
+  glGenTextures(1, &visibleTexture);
+}
+
+LabelRenderer::~LabelRenderer() {
+  GLState &state = GLState::current();
+  state.forgetVertexArray(VAO);
+  glDeleteVertexArrays(1, &VAO);
+  state.forgetBuffer(glyphVBO);
+  state.forgetBuffer(visibleVBO);
+  unsigned int buffers[2] = { glyphVBO, visibleVBO };
+  glDeleteBuffers(2, buffers);
+  unsigned int textures[2] = { atlasTexture, visibleTexture };
+  glDeleteTextures(2, textures);
+}
+
+void LabelRenderer::extent(const std::string &text, float &width, float &height) const {
+  float unitPixels = textSize / atlas.capHeight;
+  // the halo reaches about a unit past the strokes
+  width = (text.size() * atlas.advance - (atlas.advance - 4.0f) + 2.0f) * unitPixels;
+  height = (atlas.capHeight + 2.0f) * unitPixels;
+}
+
+void LabelRenderer::setLabels(const std::vector<Label> &labels) {
+  std::vector<Glyph> glyphs;
+  for(int l = 0; l < (int) labels.size(); l++) {
+    const Label &label = labels[l];
+    // centered on the anchor, horizontally and on half the cap height
+    float pen = -0.5f * (label.text.size() * atlas.advance - (atlas.advance - 4.0f));
+    for(char c : label.text) {
+      int cell = atlas.glyph(c);
+      if(cell >= 0)
+        glyphs.push_back({ { label.x, label.y }, { pen, -0.5f * atlas.capHeight }, cell, l });
+      pen += atlas.advance;
+    }
+  }
+  glyphCount = glyphs.size();
+  labelCount = labels.size();
+
+  GLState &state = GLState::current();
+  state.bindBuffer(GL_ARRAY_BUFFER, glyphVBO);
+  glBufferData(GL_ARRAY_BUFFER, glyphs.size()*sizeof(Glyph), glyphs.data(), GL_STATIC_DRAW);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // a byte per label, a few KB even for thousands of zones
+  std::vector<unsigned char> visible(std::max(labelCount, 1), 1);
+  state.bindBuffer(GL_TEXTURE_BUFFER, visibleVBO);
+  glBufferData(GL_TEXTURE_BUFFER, visible.size(), visible.data(), GL_DYNAMIC_DRAW);
+  state.bindBuffer(GL_TEXTURE_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_BUFFER, visibleTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, visibleVBO);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  std::cout << "Labels: " << labels.size() << " labels, " << glyphCount << " glyphs" << std::endl;
+}
+
+void LabelRenderer::setVisible(const std::vector<unsigned char> &visible) {
+  if((int) visible.size() != labelCount || labelCount == 0)
+    return;
+  GLState &state = GLState::current();
+  state.bindBuffer(GL_TEXTURE_BUFFER, visibleVBO);
+  glBufferSubData(GL_TEXTURE_BUFFER, 0, visible.size(), visible.data());
+  state.bindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LabelRenderer::record(CommandList &list, Shader &shader) const {
+  if(glyphCount == 0)
+    return;
+  if(timers)
+    list.beginTimer(timers, "labels");
+  list.blend(true);
+  list.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  LabelUniforms uniforms;
+  std::copy(view, view + 16, uniforms.view);
+  std::copy(viewport, viewport + 2, uniforms.viewport);
+  uniforms.unitPixels = textSize / atlas.capHeight;
+  uniforms.columns = atlas.columns;
+  uniforms.cell[0] = atlas.cellWidth;
+  uniforms.cell[1] = atlas.cellHeight;
+  uniforms.atlasSize[0] = atlas.width;
+  uniforms.atlasSize[1] = atlas.height;
+  uniforms.texelsPerUnit = atlas.texelsPerUnit;
+  uniforms.padding = atlas.padding;
+  uniforms.spread = atlas.spread;
+  list.useProgram(&shader);
+  list.setUniforms(uniforms);
+  list.bindTexture(0, GL_TEXTURE_2D, atlasTexture);
+  list.bindTexture(1, GL_TEXTURE_BUFFER, visibleTexture);
+  list.bindVertexArray(VAO);
+  list.drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, glyphCount);
+  list.blend(false);
+  if(timers)
+    list.endTimer(timers);
+}
+
+void LabelRenderer::draw(Shader &shader) {
+  frame.clear();
+  record(frame, shader);
+  frame.replay();
+}
@@ -1,20 +1,76 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <shapefil.h>
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
 #include <vector>
 
 #include "shader.hpp"
+#include "camera.hpp"
+#include "context.hpp"
+#include "flow_renderer.hpp"
+#include "frame_capture.hpp"
+#include "gl_state.hpp"
+#include "gpu_timer.hpp"
+#include "heatmap.hpp"
+#include "image.hpp"
+#include "label_placer.hpp"
+#include "label_renderer.hpp"
+#include "map.hpp"
+#include "od_matrix.hpp"
+#include "picker.hpp"
+#include "render_scheduler.hpp"
+#include "renderer.hpp"
+#include "shader_watcher.hpp"
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow* window);
+void window_refresh_callback(GLFWwindow* window);
+void processInput(GLFWwindow* window, int key, int scancode, int action, int mods);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int);
+void cursor_position_callback(GLFWwindow* window, double x, double y);
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
 const unsigned int SCR_HEIGHT = 512;
 const unsigned int SCR_WIDTH = 512;
 unsigned int POLYGON_MODE = GL_FILL;
+MapRenderer::FillMode FILL_MODE = MapRenderer::FILL_FAN;
+// analytic anti-aliased outlines (and fill edges), see MapRenderer::lineShader
+bool ANTIALIAS = false;
+float OUTLINE_WIDTH = 1.2f;
+// cull shapes against the view in a compute pass, see MapRenderer::cullShader
+bool GPU_CULLING = false;
+// raw trips behind the flow layer, re-aggregated when the filter changes
+TripTable TRIPS;
+TripFilter TRIP_FILTER;
+// H steps through 3 hour windows of the day, -1 is the whole day
+int HOUR_WINDOW = -1;
+bool REAGGREGATE = false;
+// what the heatmap counts: trip origins or destinations (per zone, from the
+// aggregated matrix) or the points of a --points file
+enum HeatmapSource { HEAT_NONE, HEAT_ORIGINS, HEAT_DESTINATIONS, HEAT_POINTS };
+HeatmapSource HEATMAP_SOURCE = HEAT_NONE;
+// zone labels over every other layer
+bool LABELS = false;
+// only redraw when something marked the frame dirty (see RenderScheduler)
+RenderScheduler scheduler;
+// pan/zoom over the map, the only thing that changes when moving around
+Camera camera;
+// last cursor position while dragging with the left button, in pixels
+bool DRAGGING = false;
+double DRAG_X, DRAG_Y;
+// cursor in framebuffer pixels (y down), the zone under it is looked up
+// on the GPU when it moves, see Picker
+int HOVER_X = -1, HOVER_Y = -1;
+bool PICK_REQUESTED = false;
+// P saves the next frame, V starts/stops recording (see FrameCapture)
+bool SCREENSHOT = false;
+bool TOGGLE_RECORDING = false;
 
 GLenum glCheckError_(const char *file, int line)
 {
@@ -38,222 +94,663 @@ GLenum glCheckError_(const char *file, int line)
 }
 #define glCheckError() glCheckError_(__FILE__, __LINE__)
 
-std::vector<int> shapeCounts;
-
-std::vector<float> loadMap() {
-
-  std::vector<float> points;
-
-  int nEntities, pnShapeType;
-  double padfMinBound[4], padfMaxBound[4];
-  SHPHandle myHandler = SHPOpen("/home/tallys/git/od-analysis/datasets/od1987/raw/Mapas/Shape/Zonas1987_region", "rb");
-	if(myHandler == NULL) {
-		std::cout << __FILE__ << ":" << __LINE__ <<" [E]:Nao foi possivel abrir shapefile. Abortando execução!\n" ;
-		exit(-1);
-	}
-
-  SHPGetInfo(myHandler, &nEntities, &pnShapeType, padfMinBound, padfMaxBound);
-  shapeCounts.assign(nEntities, 0);
-  std::cout << nEntities << std::endl;
-  std::cout << pnShapeType << std::endl;
-
-  float xMin = padfMinBound[0];
-  float yMin = padfMinBound[1];
-  float xMax = padfMaxBound[0];
-  float yMax = padfMaxBound[1];
-  printf("xMin: %f, yMin: %f\n", xMin, yMin);
-  printf("xMax: %f, yMax: %f\n", xMax, yMax);
-  std::cout << "READING SHAPEFILE"  << std::endl;
-
-  for(int T=0; T<nEntities; T++){
-  //for(int T=0; T<2; T++){
-    SHPObject *obj = SHPReadObject(myHandler, T);
-    shapeCounts[T] = obj->nVertices;
-
-    std::cout << "Reading Shape " << T << std::endl;
-    std::cout << "nSHPType " << obj->nSHPType << std::endl;
-    std::cout << "nShapeId " << obj->nShapeId << std::endl;
-    std::cout << "nParts " << obj->nParts << std::endl;
-    std::cout << "*panPartStart " << *obj->panPartStart << std::endl;
-    std::cout << "nVertices " << obj->nVertices << std::endl;
-    float x, y, z = 0;
-    float rangeX = xMax - xMin;
-    float rangeY = yMax - yMin;
-    float border = 0.0;
-    float size = 2;
-    float scale=1.0;
-
-    // Get the scale based on max range X or Y axes
-    // If 
-    if (rangeX>rangeY)
-      scale  = (1-border)*size/rangeX;
-    else
-      scale  = (1-border)*size/rangeY;
 
-    float xTranslation = -scale/2;//Our points fall into 0,1 quadrant, we need to 
-    float yTranslation = -scale/2;//make a translation in both axes to center in -1,1
+// Every layer of a frame and its programs, drawn in order: map, heatmap,
+// flows, labels
+struct Scene
+{
+  const Map *map;
+  MapRenderer *renderer;
+  Shader *mapShader;
+  Shader *lineShader;
+  Shader *cullShader;
+  FlowRenderer *flows = NULL;
+  Shader *flowShader;
+  HeatmapRenderer *heatmap = NULL;
+  Shader *splatShader, *reduceShader, *colorShader;
+  LabelRenderer *labels = NULL;
+  LabelPlacer *placer = NULL;
+  Shader *labelShader;
+  // the map is drawn through it when set, so zones can be picked
+  Picker *picker = NULL;
+
+  // waits for every program, for single frames
+  void finish();
+  // draws a frame into `framebuffer`, false while a program still compiles
+  bool draw(int width, int height, unsigned int framebuffer);
+  // rebuilds the OD matrix from the raw trips under the current filter
+  void aggregate();
+};
+
+void Scene::finish()
+{
+    Shader *shaders[] = { mapShader, lineShader, cullShader, flowShader, splatShader, reduceShader, colorShader, labelShader };
+    for(Shader *shader : shaders)
+      shader->finish();
+}
 
-    for(int i=0; i < obj->nVertices; i++) {
-      // Vertex points to be draw are made of 3 float elements (X, Y, Z)
+bool Scene::draw(int width, int height, unsigned int framebuffer)
+{
+    if(REAGGREGATE)
+      aggregate();
+
+    renderer->fillMode = FILL_MODE;
+    renderer->lineShader = ANTIALIAS ? lineShader : NULL;
+    // a compute program cannot be replaced by the placeholder, cull once it is ready
+    renderer->cullShader = GPU_CULLING && cullShader->ready() ? cullShader : NULL;
+    renderer->viewport[0] = width;
+    renderer->viewport[1] = height;
+    camera.viewMatrix(renderer->view);
+    renderer->pickIds = picker != NULL;
+    if(picker) {
+      picker->resize(width, height);
+      glBindFramebuffer(GL_FRAMEBUFFER, picker->framebuffer());
+    }
+    renderer->draw(*mapShader);
+    // the other layers draw over the map's color in the real target
+    if(picker)
+      picker->blit(framebuffer);
+    bool ready = mapShader->ready() && (!ANTIALIAS || lineShader->ready()) && (!GPU_CULLING || cullShader->ready());
+
+    // the placeholder program cannot stand in for these, they appear later
+    if(heatmap && splatShader->ready() && reduceShader->ready() && colorShader->ready()) {
+      heatmap->resize(width, height);
+      heatmap->targetFramebuffer = framebuffer;
+      std::copy(renderer->view, renderer->view + 16, heatmap->view);
+      heatmap->draw(*splatShader, *reduceShader, *colorShader);
+    } else if(heatmap) {
+      ready = false;
+    }
+    if(flows && flowShader->ready()) {
+      std::copy(renderer->view, renderer->view + 16, flows->view);
+      flows->viewport[0] = width;
+      flows->viewport[1] = height;
+      flows->draw(*flowShader);
+    } else if(flows) {
+      ready = false;
+    }
+    if(labels && LABELS && labelShader->ready()) {
+      std::copy(renderer->view, renderer->view + 16, labels->view);
+      labels->viewport[0] = width;
+      labels->viewport[1] = height;
+      // pans only re-place the labels crossing the edges, see LabelPlacer
+      if(placer && placer->place(labels->view, labels->viewport))
+        labels->setVisible(placer->visible);
+      labels->draw(*labelShader);
+    } else if(labels && LABELS) {
+      ready = false;
+    }
+    return ready;
+}
 
-      //Calculate normalized vertexes for axes X and Y
-			// Normalized points fall in range [0,1]
-      x = (obj->padfX[i] - xMin)/(xMax - xMin); 
-      y = (obj->padfY[i] - yMin)/(yMax - yMin);
-      fprintf(stderr, "%f, %f,\n", x, y);
+void Scene::aggregate()
+{
+    REAGGREGATE = false;
+    int zones = map->shapeCounts.size();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ODMatrix matrix = aggregateTrips(TRIPS, zones, TRIP_FILTER);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Aggregated " << TRIPS.size() << " trips into " << matrix.nonZeros() << " OD pairs ("
+              << matrix.total << " total) in " << ms << " ms" << std::endl;
+    if(flows)
+      flows->setPairs(matrix.pairs());
+
+    // the trips of a zone all splat at its centroid, one weighted point each
+    if(heatmap && (HEATMAP_SOURCE == HEAT_ORIGINS || HEATMAP_SOURCE == HEAT_DESTINATIONS)) {
+      const std::vector<double> &totals = HEATMAP_SOURCE == HEAT_ORIGINS ? matrix.rowTotals : matrix.columnTotals;
+      std::vector<float> centroids = shapeCentroids(*map);
+      std::vector<float> points;
+      for(int z = 0; z < zones; z++) {
+        if(totals[z] <= 0)
+          continue;
+        points.push_back(centroids[2*z]);
+        points.push_back(centroids[2*z+1]);
+        points.push_back(totals[z]);
+      }
+      heatmap->setPoints(points);
+    }
+}
 
-			//Scale points and make a translation to center points in between [-1,1]
-      x = x*scale+xTranslation;
-      y = y*scale+yTranslation;
+// One label per zone at its centroid: the `field` attribute of the map's
+// table, or the zone id when there is none
+static std::vector<Label> zoneLabels(const Map &map, const char* mapPath, const char* field, int zoneBase)
+{
+    std::vector<std::string> names;
+    if(field)
+      names = loadAttribute(mapPath, field);
+    std::vector<float> centroids = shapeCentroids(map);
+    std::vector<Label> labels(map.shapeCounts.size());
+    for(size_t z = 0; z < labels.size(); z++) {
+      labels[z].x = centroids[2*z];
+      labels[z].y = centroids[2*z+1];
+      labels[z].text = z < names.size() ? names[z] : std::to_string(z + zoneBase);
+    }
+    return labels;
+}
 
-      //Add X, Y, Z coordinates to points data array
-      points.push_back(x);
-      points.push_back(y);
-      points.push_back(z); // z = 0;
+// Draws a single frame into an offscreen context and writes it to `output`
+int renderOffscreen(Context &context, Scene &scene, const char* output)
+{
+    int width, height;
+    context.size(width, height);
+
+    // there is only one frame, so wait for the real programs instead of the placeholder
+    scene.finish();
+    camera.resize(width, height);
+    scene.draw(width, height, context.framebuffer());
+    context.present();
+    if(scene.placer && LABELS)
+      std::cout << "Placed " << scene.placer->placedCount << " of " << scene.placer->visible.size()
+                << " labels in " << scene.placer->lastMs << " ms" << std::endl;
+    if(scene.picker) {
+      scene.picker->request(HOVER_X, height - 1 - HOVER_Y);
+      glFinish();
+      scene.picker->poll();
+      std::cout << "Zone at " << HOVER_X << "," << HOVER_Y << ": " << scene.picker->zone << std::endl;
+    }
+    glCheckError();
 
+    Image image = readFramebuffer(context.framebuffer(), width, height);
+    if(!writeImage(output, image))
+      return -1;
+    std::cout << "Wrote " << width << "x" << height << " frame to " << output << std::endl;
+    return 0;
+}
 
+// Renders `frames` offscreen frames slowly zooming into the center and
+// records each one, e.g. a clip for a report
+int recordOffscreen(Context &context, Scene &scene, FrameCapture &capture, GPUTimers &timers, int frames)
+{
+    int width, height;
+    context.size(width, height);
+
+    scene.finish();
+    camera.resize(width, height);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int i = 0; i < frames; i++) {
+      scene.draw(width, height, context.framebuffer());
+      capture.capture(context.framebuffer(), width, height);
+      context.present();
+      timers.endFrame();
+      camera.zoomAt(1.01, width / 2.0, height / 2.0);
     }
-  }
-
-  return points;
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Drew " << frames << " frames in " << s << " s (" << frames / s << " fps)" << std::endl;
+    std::cout << "GPU time per pass:" << std::endl;
+    timers.report(std::cout);
+    capture.stop();
+    glCheckError();
+    return 0;
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    std::vector<float> points = loadMap();
-    int N = points.size();
+    const char* mapPath = DEFAULT_MAP_PATH;
+    const char* output = "map.png";
+    const char* flowsPath = NULL;
+    const char* tripsPath = NULL;
+    const char* pointsPath = NULL;
+    const char* labelField = NULL;
+    const char* priorityField = NULL;
+    int zoneBase = 0;
+    const char* recordTarget = NULL;
+    int fps = 60;
+    int frames = 1;
+    bool headless = false;
+    bool watchShaders = false;
+    int width = SCR_WIDTH;
+    int height = SCR_HEIGHT;
+    for(int i=1; i<argc; i++) {
+      std::string arg(argv[i]);
+      // --continuous: redraw at full speed like before, for profiling
+      if(arg == "--continuous")
+        scheduler.continuous = true;
+      // --headless: no window, render one frame offscreen and save it
+      else if(arg == "--headless")
+        headless = true;
+      else if(arg == "--output" && i+1 < argc)
+        output = argv[++i];
+      else if(arg == "--map" && i+1 < argc)
+        mapPath = argv[++i];
+      else if(arg == "--size" && i+1 < argc)
+        sscanf(argv[++i], "%dx%d", &width, &height);
+      // --aa: analytic anti-aliasing of outlines and fill edges, no MSAA
+      else if(arg == "--aa")
+        ANTIALIAS = true;
+      // --flows <csv>: OD pairs (origin,destination,volume) drawn as arcs
+      else if(arg == "--flows" && i+1 < argc)
+        flowsPath = argv[++i];
+      // --trips <csv|bin>: raw trips, aggregated into the flow layer
+      else if(arg == "--trips" && i+1 < argc)
+        tripsPath = argv[++i];
+      // --purpose N, --mode N, --hours a-b: which trips are counted
+      else if(arg == "--purpose" && i+1 < argc)
+        TRIP_FILTER.purposes = 1ull << (atoi(argv[++i]) & 63);
+      else if(arg == "--mode" && i+1 < argc)
+        TRIP_FILTER.modes = 1ull << (atoi(argv[++i]) & 63);
+      else if(arg == "--hours" && i+1 < argc) {
+        int first = 0, last = 23;
+        sscanf(argv[++i], "%d-%d", &first, &last);
+        TRIP_FILTER.hourRange(first, last);
+      }
+      // --heatmap origins|destinations: density of the trips' endpoints
+      else if(arg == "--heatmap" && i+1 < argc) {
+        std::string source(argv[++i]);
+        HEATMAP_SOURCE = source == "destinations" ? HEAT_DESTINATIONS : HEAT_ORIGINS;
+      }
+      // --points <csv>: density of x,y[,weight] points in the map's coordinates
+      else if(arg == "--points" && i+1 < argc) {
+        pointsPath = argv[++i];
+        HEATMAP_SOURCE = HEAT_POINTS;
+      }
+      // --zone-base N: id of the first zone in the flows/trips file
+      else if(arg == "--zone-base" && i+1 < argc)
+        zoneBase = atoi(argv[++i]);
+      // --labels: zone ids over the map, --label-field NAME: a .dbf column instead
+      else if(arg == "--labels")
+        LABELS = true;
+      else if(arg == "--label-field" && i+1 < argc) {
+        labelField = argv[++i];
+        LABELS = true;
+      }
+      // --label-priority NAME: numeric .dbf column, larger values win
+      // collisions (the zone area by default)
+      else if(arg == "--label-priority" && i+1 < argc)
+        priorityField = argv[++i];
+      // --record <target>: records every frame, see FrameCapture::start();
+      // --fps N for the Y4M header, --frames N with --headless
+      else if(arg == "--record" && i+1 < argc)
+        recordTarget = argv[++i];
+      else if(arg == "--fps" && i+1 < argc)
+        fps = atoi(argv[++i]);
+      else if(arg == "--frames" && i+1 < argc)
+        frames = atoi(argv[++i]);
+      // --pick X,Y: with --headless, prints the zone under that pixel
+      else if(arg == "--pick" && i+1 < argc)
+        sscanf(argv[++i], "%d,%d", &HOVER_X, &HOVER_Y);
+      // --watch-shaders: rebuild programs whose sources are saved, see ShaderWatcher
+      else if(arg == "--watch-shaders")
+        watchShaders = true;
+      // --gpu-cull: viewport culling of shapes on the GPU (indirect draws)
+      else if(arg == "--gpu-cull")
+        GPU_CULLING = true;
+      // --outline <px>: outline width, 0 for none
+      else if(arg == "--outline" && i+1 < argc)
+        OUTLINE_WIDTH = atof(argv[++i]);
+      // --fill fan|stencil|nonzero: how polygons are filled, see MapRenderer
+      else if(arg == "--fill" && i+1 < argc) {
+        if(!parseFillMode(argv[++i], FILL_MODE))
+          std::cout << "Unknown fill mode " << argv[i] << ", using fan" << std::endl;
+      }
+    }
+
+    std::unique_ptr<Context> context;
+    if(headless)
+      context.reset(new HeadlessContext(width, height));
+    else
+      context.reset(new WindowContext(width, height, "LearnOpenGL"));
+    if(!context->valid() || !context->loadGL())
+      return -1;
 
-    glfwInit();
+    // hot reload needs files to watch instead of the embedded copies, this
+    // checkout's by default ($LEARNOPENGL_SHADER_DIR picks another)
+    if(watchShaders && shaderDirectory().empty())
+      setShaderDirectory("src/shaders");
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Submit every program up front: the driver compiles them in the background
+    // while we read the shapefile, and each one is only waited on at first use()
+    // map program variants (VERTEX_COLOR, PICK_IDS), only the one used is
+    // compiled: with zone ids when picking (window, or --pick)
+    ShaderPermutations mapPrograms("points.vert", "static_color.frag");
+    bool picking = !headless || HOVER_X >= 0;
+    Shader &mapShaderProgram = mapPrograms.get(picking ? ShaderDefines{{"PICK_IDS", ""}} : ShaderDefines());
 
-#ifdef __APPLE__
-    //*MacOS specific to force CORE profile only
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+    Shader lineShaderProgram("aa_line.vert", "aa_line.frag");
 
-    // GLFW window creation
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "LearnOpenGL", NULL, NULL);
-    if (window == NULL)
-    {
-      std::cout << "Failed to create GLFW window" << std::endl;
-      glfwTerminate();
-      return -1;
-    }
+    Shader cullShaderProgram("cull.comp");
 
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    Shader flowShaderProgram("flow.vert", "flow.frag");
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-      std::cout << "Failed to initialize GLAD" << std::endl;
-      return -1;
-    }
+    Shader splatShaderProgram("heat_splat.vert", "heat_splat.frag");
 
-    //Create, Bind and Write data to our points data buffer
-    unsigned int points_VBO;
-    glGenBuffers(1, &points_VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, points_VBO);
-    glBufferData(GL_ARRAY_BUFFER, N*sizeof(float), points.data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);//unbind
+    Shader reduceShaderProgram("heat_max.comp");
 
-    //Create our VAO object bind to it and setup object configuration for drawing
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
+    Shader heatColorShaderProgram("heat_color.vert", "heat_color.frag");
 
-    //setup points_VBO to index 0 in our shader
-    glBindBuffer(GL_ARRAY_BUFFER, points_VBO);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+    Shader labelShaderProgram("label.vert", "label.frag");
 
-    //Enable previously created shader attributes (stored in newer versions of OpenGL)
-    glEnableVertexAttribArray(0);
+    Map map = loadMap(mapPath);
+    MapRenderer renderer(map);
+    renderer.fillMode = FILL_MODE;
+    renderer.lineShader = ANTIALIAS ? &lineShaderProgram : NULL;
+    renderer.fillEdgeAA = true;
+    renderer.outlineWidth = OUTLINE_WIDTH;
+    // per pass GPU times, read back a few frames late so they never stall
+    GPUTimers timers;
+    renderer.timers = &timers;
 
-    // Unbind
-    glBindVertexArray(0);
+    bool hasTrips = tripsPath && loadTrips(tripsPath, TRIPS, zoneBase);
+    REAGGREGATE = hasTrips;
 
-    Shader redShaderProgram("/home/tallys/git/learnopengl/src/shaders/points.vert", "/home/tallys/git/learnopengl/src/shaders/dynamic_color.frag");
+    std::unique_ptr<FlowRenderer> flows;
+    if(flowsPath)
+      flows.reset(new FlowRenderer(map, loadODPairs(flowsPath, zoneBase)));
+    else if(hasTrips && HEATMAP_SOURCE == HEAT_NONE)
+      flows.reset(new FlowRenderer(map, std::vector<ODPair>()));
+    if(flows)
+      flows->timers = &timers;
 
-    Shader orangeShaderProgram("/home/tallys/git/learnopengl/src/shaders/points.vert", "/home/tallys/git/learnopengl/src/shaders/static_color.frag");
+    std::unique_ptr<HeatmapRenderer> heatmap;
+    if(HEATMAP_SOURCE == HEAT_POINTS || (HEATMAP_SOURCE != HEAT_NONE && hasTrips)) {
+      heatmap.reset(new HeatmapRenderer());
+      heatmap->timers = &timers;
+      if(pointsPath)
+        heatmap->setPoints(loadPoints(pointsPath, map));
+    }
 
+    // windows can toggle labels at runtime, so they are always built there
+    std::unique_ptr<LabelRenderer> labels;
+    LabelPlacer placer;
+    if(LABELS || !headless) {
+      labels.reset(new LabelRenderer());
+      labels->timers = &timers;
+      std::vector<Label> zones = zoneLabels(map, mapPath, labelField, zoneBase);
+      labels->setLabels(zones);
+
+      std::vector<float> priority = shapeAreas(map);
+      if(priorityField) {
+        std::vector<std::string> values = loadAttribute(mapPath, priorityField);
+        for(size_t z = 0; z < values.size() && z < priority.size(); z++)
+          priority[z] = atof(values[z].c_str());
+      }
+      std::vector<float> anchors, sizes;
+      for(const Label &label : zones) {
+        float w, h;
+        labels->extent(label.text, w, h);
+        anchors.push_back(label.x);
+        anchors.push_back(label.y);
+        sizes.push_back(w);
+        sizes.push_back(h);
+      }
+      placer.setLabels(anchors, sizes, priority);
+    }
 
-    float timeValue = 0;
+    // hovering needs it in a window, a single frame only with --pick
+    std::unique_ptr<Picker> picker;
+    if(picking)
+      picker.reset(new Picker());
+
+    Scene scene;
+    scene.map = &map;
+    scene.renderer = &renderer;
+    scene.mapShader = &mapShaderProgram;
+    scene.lineShader = &lineShaderProgram;
+    scene.cullShader = &cullShaderProgram;
+    scene.flows = flows.get();
+    scene.flowShader = &flowShaderProgram;
+    scene.heatmap = heatmap.get();
+    scene.splatShader = &splatShaderProgram;
+    scene.reduceShader = &reduceShaderProgram;
+    scene.colorShader = &heatColorShaderProgram;
+    scene.labels = labels.get();
+    scene.placer = labels ? &placer : NULL;
+    scene.picker = picker.get();
+    scene.labelShader = &labelShaderProgram;
+
+    // frames are read back without stalling and encoded on another thread
+    FrameCapture capture;
+    if(recordTarget && !capture.start(recordTarget, fps))
+      return -1;
+    // recording needs a frame every iteration, not only on changes
+    bool continuous = scheduler.continuous;
+    scheduler.continuous = continuous || capture.recording();
+
+    // offline: every frame counts more than the frame rate
+    capture.lossless = headless;
+    if(headless && recordTarget)
+      return recordOffscreen(*context, scene, capture, timers, frames);
+    if(headless)
+      return renderOffscreen(*context, scene, output);
+
+    GLFWwindow* window = static_cast<WindowContext&>(*context).window;
+    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    glfwSetWindowRefreshCallback(window, window_refresh_callback);
+    glfwSetKeyCallback(window, processInput);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetCursorPosCallback(window, cursor_position_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    context->size(width, height);
+    camera.resize(width, height);
+    // lets other threads (data updates) wake the loop out of glfwWaitEventsTimeout
+    scheduler.wake = glfwPostEmptyEvent;
+
+    // compiles edited shaders on a hidden context of its own, the frame
+    // keeps the old program until the new one linked
+    std::unique_ptr<ShaderWatcher> watcher;
+    if(watchShaders) {
+      WindowContext *worker = new WindowContext(1, 1, "shader watcher", static_cast<WindowContext*>(context.get()));
+      std::vector<Shader*> shaders = mapPrograms.built();
+      shaders.insert(shaders.end(), { &lineShaderProgram, &cullShaderProgram, &flowShaderProgram, &splatShaderProgram,
+                                      &reduceShaderProgram, &heatColorShaderProgram, &labelShaderProgram });
+      if(worker->valid())
+        watcher.reset(new ShaderWatcher(worker, shaders, [] { scheduler.invalidate(); }));
+      else
+        delete worker;
+    }
 
     // #######################################################################
     // RENDER LOOP
     // #######################################################################
-    float alpha = 1.0;
     while(!glfwWindowShouldClose(window))
     {
-      glCheckError();
-
-      //clear openGL buffer (can be COLOR, STENCIL and DEPTH) filling them with the given
-      // glClearColor
-      glClearColor(0.0f, 0.0f, 0.1f, alpha);
-      glClear(GL_COLOR_BUFFER_BIT);
+      // nothing changed: sleep until an event arrives instead of redrawing
+      double now = glfwGetTime();
+      if(picker->poll()) {
+        std::string title = "LearnOpenGL";
+        if(picker->zone >= 0)
+          title += " - zone " + std::to_string(picker->zone + zoneBase);
+        glfwSetWindowTitle(window, title.c_str());
+      }
+      if(!scheduler.needsRedraw(now)) {
+        // the cursor moved over an unchanged frame: look it up right away
+        if(PICK_REQUESTED)
+          picker->request(HOVER_X, height - 1 - HOVER_Y);
+        PICK_REQUESTED = false;
+        // come back soon for a lookup in flight
+        glfwWaitEventsTimeout(picker->pending() ? 0.002 : scheduler.timeout(now));
+        continue;
+      }
+      scheduler.beginFrame();
 
-      //input
-      processInput(window);
+      glCheckError();
 
-      orangeShaderProgram.use();
-      int loc = glGetUniformLocation(orangeShaderProgram.ID, "c");
-      std::cout << "loc = " << loc << std::endl;
-      orangeShaderProgram.setFloat("c", 1);
-      glBindVertexArray(VAO); // seeing as we only have a single VAO there's no need to bind it every time, but we'll do so to keep things a bit more organized
+      context->size(width, height);
+      // still drawing with the placeholder, come back once it is compiled
+      if(!scene.draw(width, height, context->framebuffer()))
+        scheduler.invalidate();
 
-      // Draw elements from Element Buffer Object (use indices to avoid duplicated data)
-      //glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+      glCheckError();
 
-      int last = 0;
-      for(int j=0; j<shapeCounts.size(); j++) {
-        glDrawArrays(GL_TRIANGLE_FAN, last, shapeCounts[j]);
-        last += shapeCounts[j];
+      // the zone under the cursor may have changed with the frame
+      picker->request(HOVER_X, height - 1 - HOVER_Y);
+      PICK_REQUESTED = false;
+
+      if(SCREENSHOT) {
+        static int shots = 0;
+        char path[64];
+        snprintf(path, sizeof(path), "screenshot-%03d.png", shots++);
+        capture.screenshot(path);
+        std::cout << "Screenshot: " << path << std::endl;
+        SCREENSHOT = false;
       }
-      //glDrawArrays(GL_TRIANGLE_FAN, 0, N/3);
-
-      last = 0;
-      orangeShaderProgram.setFloat("c", 0);
-      glLineWidth(1.2);
-      for(int j=0; j<shapeCounts.size(); j++) {
-        glDrawArrays(GL_LINE_LOOP, last, shapeCounts[j]);
-        last += shapeCounts[j];
+      if(TOGGLE_RECORDING) {
+        if(capture.recording())
+          capture.stop();
+        else
+          capture.start(recordTarget ? recordTarget : "capture.y4m", fps);
+        scheduler.continuous = continuous || capture.recording();
+        TOGGLE_RECORDING = false;
       }
-
-      glCheckError();
-      // glBindVertexArray(0); // no need to unbind it every time
+      capture.capture(context->framebuffer(), width, height);
 
       // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-      glfwSwapBuffers(window);
+      context->present();
+      timers.endFrame();
       glfwPollEvents();
 
     }
 
-    // Delete all GLFW resources
-    glfwTerminate();
+    std::cout << "GL state cache:" << std::endl;
+    GLState::current().report(std::cout);
+    std::cout << "GPU time per pass:" << std::endl;
+    timers.report(std::cout);
+
     return 0;
 }
 
-void processInput(GLFWwindow* window) {
+// Cursor positions are in screen coordinates, the camera works in
+// framebuffer pixels (they differ on high DPI displays)
+static void cursorToPixels(GLFWwindow* window, double &x, double &y) {
+  int windowWidth, windowHeight, width, height;
+  glfwGetWindowSize(window, &windowWidth, &windowHeight);
+  glfwGetFramebufferSize(window, &width, &height);
+  if(windowWidth > 0 && windowHeight > 0) {
+    x *= (double) width / windowWidth;
+    y *= (double) height / windowHeight;
+  }
+}
+
+// Camera keys: arrows pan, +/- zoom, R resets. Returns false for other keys
+static bool cameraKey(GLFWwindow* window, int key) {
+  int width, height;
+  glfwGetFramebufferSize(window, &width, &height);
+  switch(key) {
+    case GLFW_KEY_LEFT:        camera.pan(width / 10.0, 0); break;
+    case GLFW_KEY_RIGHT:       camera.pan(-width / 10.0, 0); break;
+    case GLFW_KEY_UP:          camera.pan(0, height / 10.0); break;
+    case GLFW_KEY_DOWN:        camera.pan(0, -height / 10.0); break;
+    case GLFW_KEY_EQUAL:
+    case GLFW_KEY_KP_ADD:      camera.zoomAt(1.25, width / 2.0, height / 2.0); break;
+    case GLFW_KEY_MINUS:
+    case GLFW_KEY_KP_SUBTRACT: camera.zoomAt(0.8, width / 2.0, height / 2.0); break;
+    case GLFW_KEY_R:           camera.reset(); break;
+    default: return false;
+  }
+  scheduler.invalidate();
+  return true;
+}
 
-  if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+// Key events arrive through glfwSetKeyCallback, so a press toggles once
+// instead of every frame the key is held (camera keys repeat while held)
+void processInput(GLFWwindow* window, int key, int, int action, int) {
+  if(action == GLFW_RELEASE || cameraKey(window, key) || action != GLFW_PRESS)
+    return;
+
+  if(key == GLFW_KEY_ESCAPE) {
     glfwSetWindowShouldClose(window, true);
     std::cout << "ESC key pressed, exiting... bye bye!" << std::endl;
   }
 
-  if(glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-     glPolygonMode(GL_FRONT_AND_BACK, POLYGON_MODE);
+  if(key == GLFW_KEY_SPACE) {
+     scheduler.invalidate();
      if(POLYGON_MODE == GL_FILL) {
        POLYGON_MODE = GL_LINE;
      } else {
        POLYGON_MODE = GL_FILL;
      }
+     GLState::current().polygonMode(POLYGON_MODE);
+  }
+
+  // A toggles analytic anti-aliasing
+  if(key == GLFW_KEY_A) {
+    ANTIALIAS = !ANTIALIAS;
+    scheduler.invalidate();
+  }
+
+  // H steps the trips' hour window: whole day, 0-2, 3-5, ..., 21-23
+  if(key == GLFW_KEY_H && TRIPS.size()) {
+    HOUR_WINDOW = HOUR_WINDOW == 7 ? -1 : HOUR_WINDOW + 1;
+    if(HOUR_WINDOW < 0)
+      TRIP_FILTER.hourRange(0, 23);
+    else
+      TRIP_FILTER.hourRange(3 * HOUR_WINDOW, 3 * HOUR_WINDOW + 2);
+    std::cout << "Hours: " << (HOUR_WINDOW < 0 ? 0 : 3 * HOUR_WINDOW) << "-" << (HOUR_WINDOW < 0 ? 23 : 3 * HOUR_WINDOW + 2) << std::endl;
+    REAGGREGATE = true;
+    scheduler.invalidate();
+  }
+
+  // C toggles GPU culling
+  if(key == GLFW_KEY_C) {
+    GPU_CULLING = !GPU_CULLING;
+    scheduler.invalidate();
+  }
+
+  // P saves a screenshot, V starts or stops recording
+  if(key == GLFW_KEY_P || key == GLFW_KEY_V) {
+    SCREENSHOT |= key == GLFW_KEY_P;
+    TOGGLE_RECORDING |= key == GLFW_KEY_V;
+    scheduler.invalidate();
+  }
+
+  // L toggles the zone labels
+  if(key == GLFW_KEY_L) {
+    LABELS = !LABELS;
+    scheduler.invalidate();
+  }
+
+  // F cycles fan -> stencil (even-odd) -> stencil (nonzero)
+  if(key == GLFW_KEY_F) {
+    FILL_MODE = (MapRenderer::FillMode) ((FILL_MODE + 1) % (MapRenderer::FILL_STENCIL_NONZERO + 1));
+    scheduler.invalidate();
   }
 }
 
 // Resize glViewport each time the user resize the window
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+void framebuffer_size_callback(GLFWwindow*, int width, int height)
 {
     glViewport(0, 0, width, height);
+    camera.resize(width, height);
+    scheduler.invalidate();
+}
+
+// The window system lost our contents (uncovered, restored), draw again
+void window_refresh_callback(GLFWwindow*)
+{
+    scheduler.invalidate();
+}
+
+// Left button drags the map
+void mouse_button_callback(GLFWwindow* window, int button, int action, int)
+{
+    if(button != GLFW_MOUSE_BUTTON_LEFT)
+      return;
+    DRAGGING = action == GLFW_PRESS;
+    if(DRAGGING) {
+      glfwGetCursorPos(window, &DRAG_X, &DRAG_Y);
+      cursorToPixels(window, DRAG_X, DRAG_Y);
+    }
+}
+
+void cursor_position_callback(GLFWwindow* window, double x, double y)
+{
+    cursorToPixels(window, x, y);
+    HOVER_X = x;
+    HOVER_Y = y;
+    PICK_REQUESTED = true;
+    if(!DRAGGING)
+      return;
+    camera.pan(x - DRAG_X, y - DRAG_Y);
+    DRAG_X = x;
+    DRAG_Y = y;
+    scheduler.invalidate();
+}
+
+// The wheel zooms around the point under the cursor
+void scroll_callback(GLFWwindow* window, double, double yoffset)
+{
+    double x, y;
+    glfwGetCursorPos(window, &x, &y);
+    cursorToPixels(window, x, y);
+    camera.zoomAt(std::pow(1.2, yoffset), x, y);
+    scheduler.invalidate();
 }
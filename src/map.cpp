@@ -0,0 +1,190 @@
+#include "map.hpp"
+
+#include <shapefil.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+const char* DEFAULT_MAP_PATH = "/home/tallys/git/od-analysis/datasets/od1987/raw/Mapas/Shape/Zonas1987_region";
+
+void projectWebMercator(double &x, double &y) {
+  // spherical mercator (EPSG:3857), clamped where the projection diverges
+  const double R = 6378137.0;
+  double lat = std::max(-85.05112878, std::min(85.05112878, y));
+  x = R * x * M_PI / 180.0;
+  y = R * std::log(std::tan(M_PI / 4.0 + lat * M_PI / 360.0));
+}
+
+Map loadMap(const char* path, bool webMercator) {
+
+  Map map;
+  map.webMercator = webMercator;
+  std::vector<float> &points = map.points;
+  std::vector<int> &shapeCounts = map.shapeCounts;
+
+  int nEntities, pnShapeType;
+  double padfMinBound[4], padfMaxBound[4];
+  SHPHandle myHandler = SHPOpen(path, "rb");
+	if(myHandler == NULL) {
+		std::cout << __FILE__ << ":" << __LINE__ <<" [E]:Nao foi possivel abrir shapefile. Abortando execução!\n" ;
+		exit(-1);
+	}
+
+  SHPGetInfo(myHandler, &nEntities, &pnShapeType, padfMinBound, padfMaxBound);
+  shapeCounts.assign(nEntities, 0);
+  std::cout << nEntities << std::endl;
+  std::cout << pnShapeType << std::endl;
+
+  if(webMercator) {
+    projectWebMercator(padfMinBound[0], padfMinBound[1]);
+    projectWebMercator(padfMaxBound[0], padfMaxBound[1]);
+  }
+  map.minBound[0] = padfMinBound[0];
+  map.minBound[1] = padfMinBound[1];
+  map.maxBound[0] = padfMaxBound[0];
+  map.maxBound[1] = padfMaxBound[1];
+
+  double xMin = padfMinBound[0];
+  double yMin = padfMinBound[1];
+  double xMax = padfMaxBound[0];
+  double yMax = padfMaxBound[1];
+  printf("xMin: %f, yMin: %f\n", xMin, yMin);
+  printf("xMax: %f, yMax: %f\n", xMax, yMax);
+  std::cout << "READING SHAPEFILE"  << std::endl;
+
+  double rangeX = xMax - xMin;
+  double rangeY = yMax - yMin;
+  double border = 0.0;
+  double size = 2;
+
+  // Get the scale based on max range X or Y axes, so the aspect ratio is kept
+  // and the whole extent fits in [-1,1]
+  if (rangeX>rangeY)
+    map.scale = (1-border)*size/rangeX;
+  else
+    map.scale = (1-border)*size/rangeY;
+  if (!(map.scale > 0) || std::isinf(map.scale))
+    map.scale = 1.0;
+
+  //Translate the center of the extent to the origin
+  map.center[0] = (xMin + xMax)/2;
+  map.center[1] = (yMin + yMax)/2;
+
+  for(int T=0; T<nEntities; T++){
+  //for(int T=0; T<2; T++){
+    SHPObject *obj = SHPReadObject(myHandler, T);
+    shapeCounts[T] = obj->nVertices;
+    for(int part=0; part < std::max(obj->nParts, 1); part++) {
+      int first = part < obj->nParts ? obj->panPartStart[part] : 0;
+      int last = part + 1 < obj->nParts ? obj->panPartStart[part+1] : obj->nVertices;
+      if(last > first)
+        map.ringCounts.push_back(last - first);
+    }
+    float x, y, z = 0;
+
+    for(int i=0; i < obj->nVertices; i++) {
+      // Vertex points to be draw are made of 3 float elements (X, Y, Z)
+      double px = obj->padfX[i];
+      double py = obj->padfY[i];
+      if(webMercator)
+        projectWebMercator(px, py);
+
+      //Center and scale in double precision, only then drop to float
+      x = (px - map.center[0])*map.scale;
+      y = (py - map.center[1])*map.scale;
+
+      //Add X, Y, Z coordinates to points data array
+      points.push_back(x);
+      points.push_back(y);
+      points.push_back(z); // z = 0;
+
+
+    }
+    SHPDestroyObject(obj);
+  }
+  SHPClose(myHandler);
+  std::cout << "READ " << points.size()/3 << " VERTICES" << std::endl;
+
+  return map;
+}
+
+void normalizePoint(const Map &map, double x, double y, float &nx, float &ny) {
+  if(map.webMercator)
+    projectWebMercator(x, y);
+  nx = (x - map.center[0])*map.scale;
+  ny = (y - map.center[1])*map.scale;
+}
+
+std::vector<float> shapeCentroids(const Map &map) {
+  std::vector<float> centroids(2 * map.shapeCounts.size());
+  const std::vector<float> &p = map.points;
+  size_t first = 0, ring = 0;
+  for(size_t j=0; j<map.shapeCounts.size(); j++) {
+    size_t n = map.shapeCounts[j];
+    // shoelace ring by ring, each closed on its own first vertex, and the
+    // moments summed: holes wind the other way and subtract
+    double area = 0, cx = 0, cy = 0, mx = 0, my = 0;
+    for(size_t end = first + n; first < end; ) {
+      size_t m = ring < map.ringCounts.size() ? map.ringCounts[ring++] : end - first;
+      for(size_t i=0; i<m; i++) {
+        size_t a = 3 * (first + i), b = 3 * (first + (i + 1) % m);
+        double cross = (double) p[a] * p[b+1] - (double) p[b] * p[a+1];
+        area += cross;
+        cx += (p[a] + p[b]) * cross;
+        cy += (p[a+1] + p[b+1]) * cross;
+        mx += p[a];
+        my += p[a+1];
+      }
+      first += m;
+    }
+    if(std::fabs(area) > 1e-12) {
+      centroids[2*j] = cx / (3.0 * area);
+      centroids[2*j+1] = cy / (3.0 * area);
+    } else if(n > 0) {
+      centroids[2*j] = mx / n;
+      centroids[2*j+1] = my / n;
+    }
+  }
+  return centroids;
+}
+
+std::vector<float> shapeAreas(const Map &map) {
+  std::vector<float> areas(map.shapeCounts.size());
+  const std::vector<float> &p = map.points;
+  size_t first = 0, ring = 0;
+  for(size_t j=0; j<map.shapeCounts.size(); j++) {
+    size_t n = map.shapeCounts[j];
+    // same per-ring shoelace as shapeCentroids()
+    double area = 0;
+    for(size_t end = first + n; first < end; ) {
+      size_t m = ring < map.ringCounts.size() ? map.ringCounts[ring++] : end - first;
+      for(size_t i=0; i<m; i++) {
+        size_t a = 3 * (first + i), b = 3 * (first + (i + 1) % m);
+        area += (double) p[a] * p[b+1] - (double) p[b] * p[a+1];
+      }
+      first += m;
+    }
+    areas[j] = std::fabs(area) * 0.5;
+  }
+  return areas;
+}
+
+std::vector<std::string> loadAttribute(const char* path, const char* field) {
+  std::vector<std::string> values;
+  DBFHandle handle = DBFOpen(path, "rb");
+  if(handle == NULL) {
+    std::cout << "ERROR::MAP::DBF_NOT_SUCCESFULLY_READ " << path << std::endl;
+    return values;
+  }
+  int index = DBFGetFieldIndex(handle, field);
+  if(index < 0)
+    std::cout << "ERROR::MAP::UNKNOWN_FIELD " << field << std::endl;
+  else
+    for(int i = 0; i < DBFGetRecordCount(handle); i++)
+      values.push_back(DBFReadStringAttribute(handle, i, index));
+  DBFClose(handle);
+  return values;
+}
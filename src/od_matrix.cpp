@@ -0,0 +1,290 @@
+#include "od_matrix.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+static const char TRIP_MAGIC[4] = { 'T', 'R', 'I', 'P' };
+static const uint32_t TRIP_VERSION = 1;
+
+// one trip of the binary format
+struct TripRecord
+{
+  int32_t origin, destination;
+  uint8_t purpose, mode, hour, unused;
+  float weight;
+};
+
+void TripTable::push(int32_t o, int32_t d, int p, int m, int h, float w) {
+  origin.push_back(o);
+  destination.push_back(d);
+  purpose.push_back(p);
+  mode.push_back(m);
+  hour.push_back(h);
+  weight.push_back(w);
+}
+
+void TripFilter::hourRange(int first, int last) {
+  // any integer is taken modulo 24, so the shift stays in range and the
+  // walk always reaches `last`
+  first = (first % 24 + 24) % 24;
+  last = (last % 24 + 24) % 24;
+  hours = 0;
+  for(int h = first; ; h = (h + 1) % 24) {
+    hours |= 1u << h;
+    if(h == last)
+      break;
+  }
+}
+
+static bool loadTripsBinary(FILE *file, TripTable &trips, int zoneBase) {
+  uint32_t version;
+  uint64_t count;
+  if(fread(&version, sizeof(version), 1, file) != 1 || version != TRIP_VERSION ||
+     fread(&count, sizeof(count), 1, file) != 1)
+    return false;
+
+  // the header must describe the file exactly before the records are sized
+  // from it: truncated or corrupt files are rejected, not allocated for
+  long header = ftell(file);
+  if(header < 0 || fseek(file, 0, SEEK_END) != 0)
+    return false;
+  long size = ftell(file);
+  if(size < header || fseek(file, header, SEEK_SET) != 0)
+    return false;
+  uint64_t bytes = size - header;
+  if(bytes % sizeof(TripRecord) != 0 || bytes / sizeof(TripRecord) != count) {
+    std::cout << "ERROR::TRIPS::SIZE_MISMATCH " << count << " records in header, "
+              << bytes << " bytes of records" << std::endl;
+    return false;
+  }
+
+  std::vector<TripRecord> records(count);
+  if(fread(records.data(), sizeof(TripRecord), count, file) != count)
+    return false;
+  for(const TripRecord &r : records)
+    trips.push(r.origin - zoneBase, r.destination - zoneBase, r.purpose, r.mode, r.hour, r.weight);
+  return true;
+}
+
+enum Column { ORIGIN, DESTINATION, PURPOSE, MODE, HOUR, WEIGHT, COLUMNS };
+
+static bool loadTripsCSV(FILE *file, TripTable &trips, int zoneBase) {
+  static const char *NAMES[COLUMNS] = { "origin", "destination", "purpose", "mode", "hour", "weight" };
+  static const char *SEPARATORS = ",; \t\r\n";
+  // position of each column in a row, -1 when absent
+  int position[COLUMNS] = { 0, 1, 2, 3, 4, 5 };
+  bool first = true;
+
+  char line[512];
+  while(fgets(line, sizeof(line), file)) {
+    char *token[16];
+    int tokens = 0;
+    for(char *t = strtok(line, SEPARATORS); t && tokens < 16; t = strtok(NULL, SEPARATORS))
+      token[tokens++] = t;
+    if(tokens == 0)
+      continue;
+
+    if(first && !isdigit((unsigned char) token[0][0]) && token[0][0] != '-') {
+      // header: columns are looked up by name
+      for(int c = 0; c < COLUMNS; c++) {
+        position[c] = -1;
+        for(int i = 0; i < tokens; i++)
+          if(strcasecmp(token[i], NAMES[c]) == 0)
+            position[c] = i;
+      }
+      first = false;
+      if(position[ORIGIN] < 0 || position[DESTINATION] < 0) {
+        std::cout << "ERROR::TRIPS::NO_ORIGIN_OR_DESTINATION_COLUMN" << std::endl;
+        return false;
+      }
+      continue;
+    }
+    first = false;
+
+    long value[COLUMNS] = { 0, 0, 0, 0, 0, 0 };
+    float weight = 1.0f;
+    bool valid = true;
+    for(int c = 0; c < COLUMNS; c++) {
+      if(position[c] < 0 || position[c] >= tokens) {
+        valid = valid && c != ORIGIN && c != DESTINATION;
+        continue;
+      }
+      char *end;
+      if(c == WEIGHT)
+        weight = strtof(token[position[c]], &end);
+      else
+        value[c] = strtol(token[position[c]], &end, 10);
+      valid = valid && end != token[position[c]];
+    }
+    if(valid)
+      trips.push(value[ORIGIN] - zoneBase, value[DESTINATION] - zoneBase,
+                 value[PURPOSE], value[MODE], value[HOUR], weight);
+  }
+  return true;
+}
+
+bool loadTrips(const char* path, TripTable &trips, int zoneBase) {
+  FILE *file = fopen(path, "rb");
+  if(!file) {
+    std::cout << "ERROR::TRIPS::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+    return false;
+  }
+  char magic[4] = { 0 };
+  bool binary = fread(magic, 1, 4, file) == 4 && memcmp(magic, TRIP_MAGIC, 4) == 0;
+  if(!binary)
+    rewind(file);
+  bool ok = binary ? loadTripsBinary(file, trips, zoneBase) : loadTripsCSV(file, trips, zoneBase);
+  fclose(file);
+  if(!ok)
+    std::cout << "ERROR::TRIPS::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+  else
+    std::cout << "READ " << trips.size() << " TRIPS" << std::endl;
+  return ok;
+}
+
+bool writeTripsBinary(const char* path, const TripTable &trips) {
+  FILE *file = fopen(path, "wb");
+  if(!file)
+    return false;
+  uint64_t count = trips.size();
+  fwrite(TRIP_MAGIC, 1, 4, file);
+  fwrite(&TRIP_VERSION, sizeof(TRIP_VERSION), 1, file);
+  fwrite(&count, sizeof(count), 1, file);
+  for(size_t i = 0; i < trips.size(); i++) {
+    TripRecord r = { trips.origin[i], trips.destination[i], trips.purpose[i], trips.mode[i], trips.hour[i], 0, trips.weight[i] };
+    fwrite(&r, sizeof(r), 1, file);
+  }
+  return fclose(file) == 0;
+}
+
+// Open addressing (linear probing) map from (origin, destination) to the
+// summed weight; much cheaper per insert than std::unordered_map
+struct CellMap
+{
+  static constexpr uint64_t EMPTY = ~0ull;
+  std::vector<uint64_t> keys;
+  std::vector<double> values;
+  size_t used = 0;
+
+  CellMap() : keys(1024, EMPTY), values(1024) {}
+
+  void add(uint64_t key, double value) {
+    if(2 * (used + 1) > keys.size())
+      grow();
+    size_t mask = keys.size() - 1;
+    // multiplicative hash, the low bits of a raw key are just the destination
+    size_t i = (key * 0x9E3779B97F4A7C15ull) >> 20 & mask;
+    while(keys[i] != EMPTY && keys[i] != key)
+      i = (i + 1) & mask;
+    if(keys[i] == EMPTY) {
+      keys[i] = key;
+      used++;
+    }
+    values[i] += value;
+  }
+
+  void grow() {
+    std::vector<uint64_t> oldKeys(2 * keys.size(), EMPTY);
+    std::vector<double> oldValues(2 * values.size());
+    oldKeys.swap(keys);
+    oldValues.swap(values);
+    used = 0;
+    for(size_t i = 0; i < oldKeys.size(); i++)
+      if(oldKeys[i] != EMPTY)
+        add(oldKeys[i], oldValues[i]);
+  }
+};
+
+ODMatrix aggregateTrips(const TripTable &trips, int zones, const TripFilter &filter, int threads) {
+  if(threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  // below this many trips a thread costs more than it saves
+  threads = std::max(1, std::min<int>(threads, trips.size() / 65536));
+
+  // 1. every worker sums its slice of the table into its own map
+  std::vector<CellMap> maps(threads);
+  auto sum = [&](int t) {
+    size_t begin = trips.size() * t / threads, end = trips.size() * (t + 1) / threads;
+    CellMap &cells = maps[t];
+    for(size_t i = begin; i < end; i++) {
+      uint32_t o = trips.origin[i], d = trips.destination[i];
+      if(o >= (uint32_t) zones || d >= (uint32_t) zones || !filter.accepts(trips.purpose[i], trips.mode[i], trips.hour[i]))
+        continue;
+      cells.add((uint64_t) o << 32 | d, trips.weight[i]);
+    }
+  };
+  std::vector<std::thread> workers;
+  for(int t = 1; t < threads; t++)
+    workers.push_back(std::thread(sum, t));
+  sum(0);
+  for(std::thread &worker : workers)
+    worker.join();
+
+  // 2. bucket every map's cells by origin (counting sort), duplicates of a
+  // cell from different workers end up in the same row
+  ODMatrix m;
+  m.zones = zones;
+  std::vector<int> start(zones + 1, 0);
+  for(const CellMap &cells : maps)
+    for(uint64_t key : cells.keys)
+      if(key != CellMap::EMPTY)
+        start[(key >> 32) + 1]++;
+  for(int o = 0; o < zones; o++)
+    start[o + 1] += start[o];
+  std::vector<std::pair<int, double>> bucket(start[zones]);
+  std::vector<int> fill(start.begin(), start.end() - 1);
+  for(const CellMap &cells : maps)
+    for(size_t i = 0; i < cells.keys.size(); i++)
+      if(cells.keys[i] != CellMap::EMPTY)
+        bucket[fill[cells.keys[i] >> 32]++] = std::make_pair((int) (cells.keys[i] & 0xFFFFFFFF), cells.values[i]);
+
+  // 3. sort each row by destination and merge duplicates into the CSR arrays
+  m.rowStart.assign(zones + 1, 0);
+  m.rowTotals.assign(zones, 0.0);
+  m.columnTotals.assign(zones, 0.0);
+  m.columns.reserve(bucket.size());
+  m.values.reserve(bucket.size());
+  for(int o = 0; o < zones; o++) {
+    std::sort(bucket.begin() + start[o], bucket.begin() + start[o + 1]);
+    for(int i = start[o]; i < start[o + 1]; i++) {
+      int d = bucket[i].first;
+      double value = bucket[i].second;
+      if(!m.columns.empty() && (int) m.columns.size() > m.rowStart[o] && m.columns.back() == d)
+        m.values.back() += value;
+      else {
+        m.columns.push_back(d);
+        m.values.push_back(value);
+      }
+      m.rowTotals[o] += value;
+      m.columnTotals[d] += value;
+      m.total += value;
+    }
+    m.rowStart[o + 1] = m.columns.size();
+  }
+  return m;
+}
+
+float ODMatrix::at(int origin, int destination) const {
+  if(origin < 0 || origin >= zones)
+    return 0;
+  std::vector<int>::const_iterator first = columns.begin() + rowStart[origin];
+  std::vector<int>::const_iterator last = columns.begin() + rowStart[origin + 1];
+  std::vector<int>::const_iterator it = std::lower_bound(first, last, destination);
+  return it != last && *it == destination ? values[it - columns.begin()] : 0;
+}
+
+std::vector<ODPair> ODMatrix::pairs() const {
+  std::vector<ODPair> result(values.size());
+  for(int o = 0; o < zones; o++)
+    for(int i = rowStart[o]; i < rowStart[o + 1]; i++) {
+      result[i].origin = o;
+      result[i].destination = columns[i];
+      result[i].volume = values[i];
+    }
+  return result;
+}
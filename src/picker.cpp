@@ -0,0 +1,126 @@
+#include "picker.hpp"
+#include "gl_state.hpp"
+
+#include <iostream>
+
+Picker::Picker() {
+  GLState &state = GLState::current();
+  glGenBuffers(SLOTS, pbos);
+  for(int i = 0; i < SLOTS; i++) {
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+    glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), NULL, GL_STREAM_READ);
+    fences[i] = 0;
+  }
+  state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  glGenFramebuffers(1, &fbo);
+  glGenRenderbuffers(1, &color);
+  glGenRenderbuffers(1, &ids);
+  glGenRenderbuffers(1, &depthStencil);
+}
+
+Picker::~Picker() {
+  for(int i = 0; i < SLOTS; i++)
+    if(fences[i])
+      glDeleteSync(fences[i]);
+  GLState &state = GLState::current();
+  for(int i = 0; i < SLOTS; i++)
+    state.forgetBuffer(pbos[i]);
+  glDeleteBuffers(SLOTS, pbos);
+  glDeleteFramebuffers(1, &fbo);
+  unsigned int renderbuffers[3] = { color, ids, depthStencil };
+  glDeleteRenderbuffers(3, renderbuffers);
+}
+
+void Picker::resize(int w, int h) {
+  if(w == width && h == height)
+    return;
+  width = w;
+  height = h;
+
+  glBindRenderbuffer(GL_RENDERBUFFER, color);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, ids);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLint previous;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_RENDERBUFFER, ids);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthStencil);
+  if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    std::cout << "ERROR::PICKER::FRAMEBUFFER_NOT_COMPLETE" << std::endl;
+  glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+  // ids of the old size are meaningless
+  for(int i = 0; i < SLOTS; i++)
+    if(fences[i]) {
+      glDeleteSync(fences[i]);
+      fences[i] = 0;
+    }
+  inFlight = 0;
+}
+
+void Picker::blit(unsigned int target) const {
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
+
+void Picker::request(int x, int y) {
+  if(x < 0 || y < 0 || x >= width || y >= height)
+    return;
+  if(inFlight == SLOTS) {
+    int oldest = (next - inFlight + SLOTS) % SLOTS;
+    glDeleteSync(fences[oldest]);
+    fences[oldest] = 0;
+    inFlight--;
+  }
+
+  GLState &state = GLState::current();
+  GLint previous;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glReadBuffer(GL_COLOR_ATTACHMENT1);
+  // with a pack buffer bound this only queues the copy
+  state.bindBuffer(GL_PIXEL_PACK_BUFFER, pbos[next]);
+  glReadPixels(x, y, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+  state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+
+  fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // without a flush the fence may never reach the GPU while we poll
+  glFlush();
+  next = (next + 1) % SLOTS;
+  inFlight++;
+}
+
+bool Picker::poll() {
+  GLState &state = GLState::current();
+  bool changed = false;
+  // in order: a newer result always replaces an older one
+  while(inFlight > 0) {
+    int oldest = (next - inFlight + SLOTS) % SLOTS;
+    GLenum status = glClientWaitSync(fences[oldest], 0, 0);
+    if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    glDeleteSync(fences[oldest]);
+    fences[oldest] = 0;
+    inFlight--;
+
+    GLuint id = 0;
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, pbos[oldest]);
+    glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), &id);
+    state.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    int picked = (int) id - 1;
+    changed |= picked != zone;
+    zone = picked;
+  }
+  return changed;
+}
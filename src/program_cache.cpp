@@ -0,0 +1,160 @@
+#include "program_cache.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+// file header in front of the raw driver blob
+struct BinaryHeader
+{
+  char magic[4];
+  GLenum format;
+  GLint length;
+};
+static const char BINARY_MAGIC[4] = {'P', 'B', 'I', 'N'};
+
+// 64-bit FNV-1a, good enough to tell shader sources apart
+static uint64_t fnv1a(const string &data, uint64_t hash = 0xcbf29ce484222325ULL) {
+  for(unsigned char c : data) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+ProgramCache::ProgramCache(const string &dir) : dir(dir) {
+}
+
+ProgramCache& ProgramCache::instance() {
+  static ProgramCache cache([] {
+    const char *env = getenv("LEARNOPENGL_SHADER_CACHE");
+    return string(env ? env : "shader_cache");
+  }());
+  return cache;
+}
+
+bool ProgramCache::enabled() {
+  if(dir.empty())
+    return false;
+
+  if(supported < 0) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+    formats.assign(count, 0);
+    if(count > 0)
+      glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+    supported = count > 0 ? 1 : 0;
+    if(!supported)
+      cout << "[I] driver exposes no program binary formats, shader cache disabled" << endl;
+  }
+  return supported == 1;
+}
+
+string ProgramCache::key(const vector<string> &sources) {
+  // the blob is only valid for the exact driver that produced it
+  const char *renderer = (const char*) glGetString(GL_RENDERER);
+  const char *version = (const char*) glGetString(GL_VERSION);
+
+  uint64_t hash = fnv1a(renderer ? renderer : "");
+  hash = fnv1a(version ? version : "", hash);
+  for(const string &source : sources) {
+    // separator so ("ab", "c") and ("a", "bc") do not collide
+    hash = fnv1a(source, hash);
+    hash = fnv1a(string(1, '\0'), hash);
+  }
+
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+  return hex;
+}
+
+string ProgramCache::path(const string &key) const {
+  return dir + "/" + key + ".bin";
+}
+
+unsigned int ProgramCache::load(const string &key) {
+  if(!enabled())
+    return 0;
+
+  ifstream file(path(key), ios::binary);
+  if(!file)
+    return 0;
+
+  // a short or corrupt file (a crash mid-write, another version) is a miss
+  BinaryHeader header = {};
+  vector<char> blob;
+  file.seekg(0, ios::end);
+  streamoff size = file.tellg();
+  file.seekg(0);
+  if(file.read((char*) &header, sizeof(header))
+     && equal(header.magic, header.magic + 4, BINARY_MAGIC)
+     && header.length > 0 && (streamoff) sizeof(header) + header.length == size) {
+    blob.resize(header.length);
+    if(!file.read(blob.data(), header.length))
+      blob.clear();
+  }
+  file.close();
+
+  // unknown format: a binary from another driver that happened to match
+  bool known = find(formats.begin(), formats.end(), (GLint) header.format) != formats.end();
+  if(blob.empty() || !known) {
+    filesystem::remove(path(key));
+    return 0;
+  }
+
+  unsigned int program = glCreateProgram();
+  glProgramBinary(program, header.format, blob.data(), header.length);
+
+  // drivers are free to reject any binary, fall back to compiling
+  int success;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  if(!success) {
+    cout << "[W] cached program " << key << " rejected by driver, recompiling" << endl;
+    glDeleteProgram(program);
+    filesystem::remove(path(key));
+    return 0;
+  }
+  return program;
+}
+
+bool ProgramCache::store(const string &key, unsigned int program) {
+  if(!enabled())
+    return false;
+
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if(length <= 0)
+    return false;
+
+  BinaryHeader header;
+  copy(BINARY_MAGIC, BINARY_MAGIC + 4, header.magic);
+  vector<char> blob(length);
+  glGetProgramBinary(program, length, &header.length, &header.format, blob.data());
+  if(header.length <= 0)
+    return false;
+
+  error_code ec;
+  filesystem::create_directories(dir, ec);
+
+  // write to a temporary name first so a concurrent reader never sees half a file
+  string target = path(key);
+  string tmp = target + ".tmp";
+  ofstream file(tmp, ios::binary | ios::trunc);
+  if(!file)
+    return false;
+  file.write((const char*) &header, sizeof(header));
+  file.write(blob.data(), header.length);
+  file.close();
+  if(!file) {
+    filesystem::remove(tmp, ec);
+    return false;
+  }
+  filesystem::rename(tmp, target, ec);
+  return !ec;
+}
@@ -0,0 +1,27 @@
+#include "render_scheduler.hpp"
+
+#include <algorithm>
+
+void RenderScheduler::invalidate() {
+  // only the first invalidation after a frame needs to wake the loop
+  if(!dirty.exchange(true) && wake)
+    wake();
+}
+
+void RenderScheduler::animate(double seconds, double now) {
+  animateUntil = std::max(animateUntil, now + seconds);
+}
+
+bool RenderScheduler::needsRedraw(double now) const {
+  return continuous || dirty.load() || now < animateUntil;
+}
+
+double RenderScheduler::timeout(double now) const {
+  if(needsRedraw(now))
+    return 0;
+  return idleTimeout;
+}
+
+void RenderScheduler::beginFrame() {
+  dirty.store(false);
+}
@@ -0,0 +1,366 @@
+#include "renderer.hpp"
+#include "gl_ext.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+
+static const float IDENTITY[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+
+MapRenderer::MapRenderer(const Map &map)
+  : shapeCounts(map.shapeCounts), ringCounts(map.ringCounts.empty() ? map.shapeCounts : map.ringCounts) {
+  GLState &state = GLState::current();
+  std::copy(IDENTITY, IDENTITY + 16, view);
+  setupShapes();
+
+  // bounding quad of the whole layer, the "cover" of stencil-then-cover
+  float xMin = 0, yMin = 0, xMax = 0, yMax = 0;
+  for(size_t i=0; i<map.points.size(); i+=3) {
+    xMin = i ? std::min(xMin, map.points[i]) : map.points[i];
+    xMax = i ? std::max(xMax, map.points[i]) : map.points[i];
+    yMin = i ? std::min(yMin, map.points[i+1]) : map.points[i+1];
+    yMax = i ? std::max(yMax, map.points[i+1]) : map.points[i+1];
+  }
+  const float cover[12] = { xMin,yMin,0, xMax,yMin,0, xMax,yMax,0, xMin,yMax,0 };
+  size_t mapBytes = map.points.size()*sizeof(float);
+
+  //Create, Bind and Write data to our points data buffer
+  glGenBuffers(1, &VBO);
+  state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, mapBytes + sizeof(cover), NULL, GL_STATIC_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, mapBytes, map.points.data());
+  glBufferSubData(GL_ARRAY_BUFFER, mapBytes, sizeof(cover), cover);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);//unbind
+
+  setupSegments(map);
+  setupZones();
+  setupBounds(map);
+  setupCommandBuffers();
+  setupVertexArray();
+}
+
+MapRenderer::MapRenderer(const MapRenderer &shared)
+  : VBO(shared.VBO), shapeCounts(shared.shapeCounts), shapeFirsts(shared.shapeFirsts),
+    ringFirsts(shared.ringFirsts), ringCounts(shared.ringCounts),
+    ownsBuffer(false), coverFirst(shared.coverFirst), segmentVBO(shared.segmentVBO),
+    pointsTexture(shared.pointsTexture), segmentCount(shared.segmentCount),
+    zoneVBO(shared.zoneVBO), boundsBuffer(shared.boundsBuffer), rangesBuffer(shared.rangesBuffer) {
+  std::copy(IDENTITY, IDENTITY + 16, view);
+  setupCommandBuffers();
+  setupVertexArray();
+}
+
+void MapRenderer::setupVertexArray() {
+  GLState &state = GLState::current();
+
+  //Create our VAO object bind to it and setup object configuration for drawing
+  glGenVertexArrays(1, &VAO);
+  state.bindVertexArray(VAO);
+
+  //setup VBO to index 0 in our shader
+  state.bindBuffer(GL_ARRAY_BUFFER, VBO);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+
+  //Enable previously created shader attributes (stored in newer versions of OpenGL)
+  glEnableVertexAttribArray(0);
+
+  // zone id per vertex, only read by picking
+  state.bindBuffer(GL_ARRAY_BUFFER, zoneVBO);
+  glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, 0, NULL);
+  glEnableVertexAttribArray(2);
+
+  // Unbind
+  state.bindVertexArray(0);
+
+  // AA lines: one integer attribute per instance
+  glGenVertexArrays(1, &lineVAO);
+  state.bindVertexArray(lineVAO);
+  state.bindBuffer(GL_ARRAY_BUFFER, segmentVBO);
+  glVertexAttribIPointer(0, 1, GL_INT, 0, NULL);
+  glVertexAttribDivisor(0, 1);
+  glEnableVertexAttribArray(0);
+  state.bindVertexArray(0);
+}
+
+void MapRenderer::setupBounds(const Map &map) {
+  GLState &state = GLState::current();
+
+  // per ring, the unit the fill and outline passes draw
+  std::vector<float> bounds(4 * ringCounts.size());
+  std::vector<int> ranges(2 * ringCounts.size());
+  for(size_t j=0; j<ringCounts.size(); j++) {
+    float *b = &bounds[4*j];
+    for(int i=ringFirsts[j]; i<ringFirsts[j]+ringCounts[j]; i++) {
+      float x = map.points[3*i], y = map.points[3*i+1];
+      bool first = i == ringFirsts[j];
+      b[0] = first ? x : std::min(b[0], x);
+      b[1] = first ? y : std::min(b[1], y);
+      b[2] = first ? x : std::max(b[2], x);
+      b[3] = first ? y : std::max(b[3], y);
+    }
+    ranges[2*j] = ringFirsts[j];
+    ranges[2*j+1] = ringCounts[j];
+  }
+
+  glGenBuffers(1, &boundsBuffer);
+  state.bindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size()*sizeof(float), bounds.data(), GL_STATIC_DRAW);
+  glGenBuffers(1, &rangesBuffer);
+  state.bindBuffer(GL_SHADER_STORAGE_BUFFER, rangesBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, ranges.size()*sizeof(int), ranges.data(), GL_STATIC_DRAW);
+  state.bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void MapRenderer::setupCommandBuffers() {
+  GLState &state = GLState::current();
+
+  // written by the GPU only, one DrawArraysIndirectCommand per ring
+  glGenBuffers(1, &commandBuffer);
+  state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, std::max<size_t>(ringCounts.size(), 1)*4*sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+  state.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glGenBuffers(1, &countBuffer);
+  state.bindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+  state.bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void MapRenderer::setupZones() {
+  GLState &state = GLState::current();
+
+  // the cover quad's vertices get no zone, they only draw color
+  std::vector<GLuint> zones(coverFirst + 4, 0);
+  for(size_t j=0; j<shapeCounts.size(); j++)
+    std::fill(zones.begin() + shapeFirsts[j], zones.begin() + shapeFirsts[j] + shapeCounts[j], j);
+
+  glGenBuffers(1, &zoneVBO);
+  state.bindBuffer(GL_ARRAY_BUFFER, zoneVBO);
+  glBufferData(GL_ARRAY_BUFFER, zones.size()*sizeof(GLuint), zones.data(), GL_STATIC_DRAW);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MapRenderer::setupSegments(const Map &map) {
+  GLState &state = GLState::current();
+
+  // Shapefile rings are closed (last vertex == first) and stored back to
+  // back, so a ring ends where its first vertex comes back; the segment
+  // from there to the next ring's start is a join, not an edge
+  std::vector<int> starts;
+  const std::vector<float> &p = map.points;
+  for(size_t j=0; j<shapeCounts.size(); j++) {
+    int ring = shapeFirsts[j];
+    int end = shapeFirsts[j] + shapeCounts[j];
+    for(int i=ring; i+1<end; i++) {
+      if(i > ring && p[3*i] == p[3*ring] && p[3*i+1] == p[3*ring+1]) {
+        ring = i + 1;
+        continue;
+      }
+      starts.push_back(i);
+    }
+  }
+  segmentCount = starts.size();
+
+  glGenBuffers(1, &segmentVBO);
+  state.bindBuffer(GL_ARRAY_BUFFER, segmentVBO);
+  glBufferData(GL_ARRAY_BUFFER, starts.size()*sizeof(int), starts.data(), GL_STATIC_DRAW);
+  state.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // the vertices themselves are not copied, the texture views the VBO
+  glGenTextures(1, &pointsTexture);
+  glBindTexture(GL_TEXTURE_BUFFER, pointsTexture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGB32F, VBO);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+MapRenderer::~MapRenderer() {
+  GLState &state = GLState::current();
+  state.forgetVertexArray(VAO);
+  glDeleteVertexArrays(1, &VAO);
+  state.forgetVertexArray(lineVAO);
+  glDeleteVertexArrays(1, &lineVAO);
+  state.forgetBuffer(commandBuffer);
+  state.forgetBuffer(countBuffer);
+  unsigned int outputs[2] = { commandBuffer, countBuffer };
+  glDeleteBuffers(2, outputs);
+  if(ownsBuffer) {
+    state.forgetBuffer(boundsBuffer);
+    state.forgetBuffer(rangesBuffer);
+    unsigned int inputs[2] = { boundsBuffer, rangesBuffer };
+    glDeleteBuffers(2, inputs);
+    state.forgetBuffer(VBO);
+    glDeleteBuffers(1, &VBO);
+    state.forgetBuffer(segmentVBO);
+    glDeleteBuffers(1, &segmentVBO);
+    state.forgetBuffer(zoneVBO);
+    glDeleteBuffers(1, &zoneVBO);
+    glDeleteTextures(1, &pointsTexture);
+  }
+}
+
+void MapRenderer::setupShapes() {
+  shapeFirsts.resize(shapeCounts.size());
+  int last = 0;
+  for(size_t j=0; j<shapeCounts.size(); j++) {
+    shapeFirsts[j] = last;
+    last += shapeCounts[j];
+  }
+  coverFirst = last;
+  ringFirsts.resize(ringCounts.size());
+  last = 0;
+  for(size_t j=0; j<ringCounts.size(); j++) {
+    ringFirsts[j] = last;
+    last += ringCounts[j];
+  }
+}
+
+void MapRenderer::record(CommandList &list, Shader &shader) const {
+  //clear openGL buffer (can be COLOR, STENCIL and DEPTH) filling them with the given
+  // glClearColor
+  bool stencil = fillMode != FILL_FAN;
+  // glClear is undefined on integer buffers, the ids are cleared apart
+  if(pickIds)
+    list.drawBuffers(1);
+  list.clear(GL_COLOR_BUFFER_BIT | (stencil ? GL_STENCIL_BUFFER_BIT : 0), 0.0f, 0.0f, 0.1f, 1.0f);
+  if(pickIds) {
+    list.drawBuffers(3);
+    list.clearBufferUint(1, 0);
+  }
+
+  if(cullShader) {
+    // without an indirect count the commands keep their slots and the
+    // culled ones draw nothing (instanceCount 0)
+    if(timers)
+      list.beginTimer(timers, "cull");
+    if(GLEXT_indirect_count)
+      list.fillBuffer(countBuffer, 0);
+    CullUniforms cull;
+    std::copy(view, view + 16, cull.view);
+    cull.compact = GLEXT_indirect_count;
+    list.useProgram(cullShader);
+    list.setUniforms(cull);
+    list.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boundsBuffer);
+    list.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, rangesBuffer);
+    list.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    list.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, countBuffer);
+    list.dispatchCompute((ringCounts.size() + 63) / 64, 1, 1);
+    list.memoryBarrier(GL_COMMAND_BARRIER_BIT);
+    if(timers)
+      list.endTimer(timers);
+  }
+
+  MapUniforms uniforms;
+  std::copy(view, view + 16, uniforms.view);
+  uniforms.c = 1;
+  list.useProgram(&shader);
+  list.setUniforms(uniforms);
+  list.bindVertexArray(VAO); // rebinding every frame is free, the state cache drops it when nothing changed
+
+  // one call per pass instead of one per shape
+  if(timers)
+    list.beginTimer(timers, "fill");
+  if(!stencil) {
+    recordShapes(list, GL_TRIANGLE_FAN);
+  } else {
+    // 1. stencil: one fan per ring, every fan triangle flips (even-odd) or
+    // counts (nonzero, by orientation) the pixels it covers, so holes and
+    // the parts of multipart shapes come out right. A fan over a shape's
+    // whole run would add the loop through its ring starts. Zones do not
+    // overlap, so all rings go in a single call.
+    // The ids are XORed in by the same triangles: a pixel inside zone z is
+    // covered an odd number of times by z's fans and an even number by any
+    // other zone's, so the XOR of all is z's id, and 0 outside every zone.
+    if(pickIds) {
+      list.drawBuffers(2);
+      list.logicOp(GL_XOR);
+    } else {
+      list.colorMask(false);
+    }
+    list.stencilTest(true);
+    list.stencilFunc(GL_ALWAYS, 0, 0xFF);
+    if(fillMode == FILL_STENCIL_EVEN_ODD) {
+      list.stencilOp(GL_FRONT_AND_BACK, GL_KEEP, GL_KEEP, GL_INVERT);
+    } else {
+      list.stencilOp(GL_FRONT, GL_KEEP, GL_KEEP, GL_INCR_WRAP);
+      list.stencilOp(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
+    }
+    recordShapes(list, GL_TRIANGLE_FAN);
+
+    // 2. cover: fill the layer's bounding quad where the stencil is set,
+    // zeroing it on the way so the next frame starts clean
+    if(pickIds) {
+      list.logicOp(GL_COPY);
+      list.drawBuffers(1);
+    }
+    list.colorMask(true);
+    list.stencilFunc(GL_NOTEQUAL, 0, 0xFF);
+    list.stencilOp(GL_FRONT_AND_BACK, GL_ZERO, GL_ZERO, GL_ZERO);
+    list.drawArrays(GL_TRIANGLE_FAN, coverFirst, 4);
+    list.stencilTest(false);
+  }
+  // the passes below write no ids
+  if(pickIds)
+    list.drawBuffers(1);
+  // an outline of at least 1px hides the fill's edge anyway
+  if(lineShader && fillEdgeAA && outlineWidth < 1.0f)
+    recordLines(list, 1, 1.0f);
+  if(timers)
+    list.endTimer(timers);
+
+  if(outlineWidth <= 0)
+    return;
+  if(timers)
+    list.beginTimer(timers, "outline");
+  if(lineShader) {
+    recordLines(list, 0, outlineWidth);
+  } else {
+    // core profiles clamp wide lines to 1px and never smooth them
+    uniforms.c = 0;
+    list.setUniforms(uniforms);
+    list.lineWidth(outlineWidth);
+    recordShapes(list, GL_LINE_LOOP);
+  }
+  if(timers)
+    list.endTimer(timers);
+}
+
+void MapRenderer::recordShapes(CommandList &list, GLenum mode) const {
+  if(cullShader)
+    list.multiDrawArraysIndirect(mode, commandBuffer, ringCounts.size(), GLEXT_indirect_count ? countBuffer : 0);
+  else
+    list.multiDrawArrays(mode, ringFirsts.data(), ringCounts.data(), ringCounts.size());
+}
+
+void MapRenderer::recordLines(CommandList &list, float c, float width) const {
+  // 4 vertices per segment, the coverage fades the quad's outer pixel, so
+  // a single sample per pixel looks like (or better than) 4x MSAA
+  list.blend(true);
+  list.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  LineUniforms uniforms;
+  std::copy(view, view + 16, uniforms.view);
+  std::copy(viewport, viewport + 2, uniforms.viewport);
+  uniforms.width = width;
+  uniforms.c = c;
+  list.useProgram(lineShader);
+  list.setUniforms(uniforms);
+  list.bindTexture(0, GL_TEXTURE_BUFFER, pointsTexture);
+  list.bindVertexArray(lineVAO);
+  list.drawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, segmentCount);
+  list.blend(false);
+}
+
+void MapRenderer::draw(Shader &shader) {
+  frame.clear();
+  record(frame, shader);
+  frame.replay();
+}
+
+bool parseFillMode(const std::string &name, MapRenderer::FillMode &mode) {
+  if(name == "fan")
+    mode = MapRenderer::FILL_FAN;
+  else if(name == "stencil")
+    mode = MapRenderer::FILL_STENCIL_EVEN_ODD;
+  else if(name == "nonzero")
+    mode = MapRenderer::FILL_STENCIL_NONZERO;
+  else
+    return false;
+  return true;
+}
@@ -0,0 +1,133 @@
+#include "sdf_font.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+// The bundled font: every glyph is a set of strokes separated by '/', each
+// stroke a polyline of "xy" points on the 4x6 grid (y up, baseline at 0).
+// A stroke of a single point is a dot.
+static const struct { char c; const char *strokes; } FONT[] = {
+  { '0', "00 40 46 06 00/01 45" },
+  { '1', "15 26 20/10 30" },
+  { '2', "06 46 43 03 00 40" },
+  { '3', "06 46 40 00/13 43" },
+  { '4', "06 03 43/46 40" },
+  { '5', "46 06 04 34 43 41 30 00" },
+  { '6', "46 06 00 40 43 03" },
+  { '7', "06 46 20" },
+  { '8', "00 40 46 06 00/03 43" },
+  { '9', "40 46 06 03 43" },
+  { 'A', "00 04 26 44 40/02 42" },
+  { 'B', "00 06 36 45 44 33 03/33 42 41 30 00" },
+  { 'C', "46 06 00 40" },
+  { 'D', "00 06 26 44 42 20 00" },
+  { 'E', "46 06 00 40/03 33" },
+  { 'F', "46 06 00/03 33" },
+  { 'G', "46 06 00 40 43 23" },
+  { 'H', "00 06/40 46/03 43" },
+  { 'I', "06 46/26 20/00 40" },
+  { 'J', "16 46 41 30 10 01" },
+  { 'K', "00 06/46 03 40" },
+  { 'L', "06 00 40" },
+  { 'M', "00 06 23 46 40" },
+  { 'N', "00 06 40 46" },
+  { 'O', "00 40 46 06 00" },
+  { 'P', "00 06 46 43 03" },
+  { 'Q', "00 06 46 42 20 00/22 40" },
+  { 'R', "00 06 46 43 03/23 40" },
+  { 'S', "46 06 03 43 40 00" },
+  { 'T', "06 46/26 20" },
+  { 'U', "06 00 40 46" },
+  { 'V', "06 20 46" },
+  { 'W', "06 00 23 40 46" },
+  { 'X', "06 40/00 46" },
+  { 'Y', "06 23 46/23 20" },
+  { 'Z', "06 46 00 40" },
+  { '-', "13 33" },
+  { '+', "13 33/22 24" },
+  { '.', "20" },
+  { ',', "21 10" },
+  { ':', "22/24" },
+  { '\'', "24 26" },
+  { '/', "00 46" },
+  { '(', "36 14 12 30" },
+  { ')', "16 34 32 10" },
+  { '?', "05 16 36 45 44 23 22/20" },
+};
+static const int GLYPHS = sizeof(FONT) / sizeof(FONT[0]);
+// half the stroke width, font units
+static const float STROKE = 0.6f;
+
+struct Segment { float ax, ay, bx, by; };
+
+static std::vector<Segment> parseGlyph(const char *strokes) {
+  std::vector<Segment> segments;
+  std::vector<float> stroke;
+  for(const char *p = strokes; ; p++) {
+    if(*p == '/' || *p == 0) {
+      // a single point is a dot, a zero length segment
+      if(stroke.size() == 2)
+        segments.push_back({ stroke[0], stroke[1], stroke[0], stroke[1] });
+      for(size_t i = 2; i < stroke.size(); i += 2)
+        segments.push_back({ stroke[i-2], stroke[i-1], stroke[i], stroke[i+1] });
+      stroke.clear();
+      if(*p == 0)
+        break;
+    } else if(isdigit(p[0]) && isdigit(p[1])) {
+      stroke.push_back(p[0] - '0');
+      stroke.push_back(p[1] - '0');
+      p++;
+    }
+  }
+  return segments;
+}
+
+static float distance(const Segment &s, float x, float y) {
+  float dx = s.bx - s.ax, dy = s.by - s.ay;
+  float length2 = dx * dx + dy * dy;
+  float t = length2 > 0 ? std::min(1.0f, std::max(0.0f, ((x - s.ax) * dx + (y - s.ay) * dy) / length2)) : 0.0f;
+  float px = s.ax + t * dx - x, py = s.ay + t * dy - y;
+  return std::sqrt(px * px + py * py);
+}
+
+int GlyphAtlas::glyph(char c) const {
+  if(isspace((unsigned char) c))
+    return -1;
+  size_t i = charset.find(toupper((unsigned char) c));
+  if(i == std::string::npos)
+    i = charset.find('?');
+  return i;
+}
+
+GlyphAtlas buildGlyphAtlas(int texelsPerUnit) {
+  GlyphAtlas atlas;
+  atlas.texelsPerUnit = texelsPerUnit;
+  atlas.spread = 1.5f;
+  atlas.padding = STROKE + atlas.spread;
+  atlas.cellWidth = std::ceil((4 + 2 * atlas.padding) * texelsPerUnit);
+  atlas.cellHeight = std::ceil((6 + 2 * atlas.padding) * texelsPerUnit);
+  atlas.columns = 16;
+  atlas.width = atlas.columns * atlas.cellWidth;
+  atlas.height = (GLYPHS + atlas.columns - 1) / atlas.columns * atlas.cellHeight;
+  atlas.pixels.assign(atlas.width * atlas.height, 0);
+
+  for(int g = 0; g < GLYPHS; g++) {
+    atlas.charset += FONT[g].c;
+    std::vector<Segment> segments = parseGlyph(FONT[g].strokes);
+    int x0 = g % atlas.columns * atlas.cellWidth;
+    int y0 = g / atlas.columns * atlas.cellHeight;
+    for(int j = 0; j < atlas.cellHeight; j++)
+      for(int i = 0; i < atlas.cellWidth; i++) {
+        // texel centers, rows bottom to top like GL textures
+        float x = (i + 0.5f) / texelsPerUnit - atlas.padding;
+        float y = (j + 0.5f) / texelsPerUnit - atlas.padding;
+        float d = 1e9f;
+        for(const Segment &s : segments)
+          d = std::min(d, distance(s, x, y));
+        float v = 0.5f + (STROKE - d) / (2 * atlas.spread);
+        atlas.pixels[(y0 + j) * atlas.width + x0 + i] = std::min(255.0f, std::max(0.0f, v * 255.0f + 0.5f));
+      }
+  }
+  return atlas;
+}
@@ -1,98 +1,414 @@
 #include "shader.hpp"
+#include "program_cache.hpp"
+#include "gl_ext.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
 
 using namespace std;
 static string SHADER_DIR = "shaders/";
 
-Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath) {
+Shader::Shader(const GLchar* vertexPath, const GLchar* fragmentPath, const ShaderDefines &defines)
+  : sourcePaths({vertexPath, fragmentPath}), defines(defines) {
   std::cout << "using vertex shader: "<< vertexPath << std::endl;
   std::cout << "using fragment shader: "<< fragmentPath << std::endl;
-  std::cout << __FILE__ << "/../shaders" << std::endl;
-  // 1. retrieve the vertex/fragment source code from filePath
-  std::string vertexCode;
-  std::string fragmentCode;
-  std::ifstream vShaderFile;
-  std::ifstream fShaderFile;
-  // ensure ifstream objects can throw exceptions:
-  vShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-  fShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-  try 
-  {
-    // open files
-    vShaderFile.open(vertexPath);
-    fShaderFile.open(fragmentPath);
-    std::stringstream vShaderStream, fShaderStream;
-    // read file's buffer contents into streams
-    vShaderStream << vShaderFile.rdbuf();
-    fShaderStream << fShaderFile.rdbuf();		
-    // close file handlers
-    vShaderFile.close();
-    fShaderFile.close();
-    // convert stream into string
-    vertexCode   = vShaderStream.str();
-    fragmentCode = fShaderStream.str();		
+  if(!defines.empty())
+    std::cout << "with defines: " << describeDefines(defines) << std::endl;
+  std::string vertexCode, fragmentCode;
+  readSources(vertexCode, fragmentCode, &dependencyPaths);
+  build(vertexCode, fragmentCode);
+}
+
+Shader::Shader(const GLchar* computePath, const ShaderDefines &defines)
+  : compute(true), sourcePaths({computePath}), defines(defines) {
+  std::cout << "using compute shader: "<< computePath << std::endl;
+  if(!defines.empty())
+    std::cout << "with defines: " << describeDefines(defines) << std::endl;
+  std::string code, unused;
+  readSources(code, unused, &dependencyPaths);
+  build(code, "");
+}
+
+bool Shader::readSources(std::string &vertexCode, std::string &fragmentCode, std::vector<std::string> *files) const {
+  std::vector<std::string> vertexFiles, fragmentFiles;
+  vertexCode = preprocessShader(sourcePaths[0], defines, &vertexFiles);
+  fragmentCode = compute ? "" : preprocessShader(sourcePaths[1], defines, &fragmentFiles);
+  if(files) {
+    // the stages first, then everything they include
+    *files = sourcePaths;
+    for(const std::vector<std::string> &read : { vertexFiles, fragmentFiles })
+      for(size_t i = 1; i < read.size(); i++)
+        if(std::find(files->begin(), files->end(), read[i]) == files->end())
+          files->push_back(read[i]);
   }
-  catch(std::ifstream::failure e)
-  {
-    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+  return !vertexCode.empty() && (compute || !fragmentCode.empty());
+}
+
+bool Shader::loadModules() {
+  spirv.clear();
+  if(!GLEXT_gl_spirv)
+    return false;
+  for(const std::string &path : sourcePaths) {
+    SpirvModule module;
+    if(!loadSpirv(path, defines, module)) {
+      spirv.clear();
+      return false;
+    }
+    spirv.push_back(module);
+  }
+  return true;
+}
+
+void Shader::build(const std::string &vertexCode, const std::string &fragmentCode) {
+  // 1. warm start: reuse the program binary linked on a previous run
+  ProgramCache &cache = ProgramCache::instance();
+  if(loadModules()) {
+    // the modules and their constants stand for the sources
+    std::vector<std::string> modules;
+    for(const SpirvModule &module : spirv) {
+      modules.push_back(std::string((const char*) module.words.data(), module.words.size() * 4));
+      for(size_t i = 0; i < module.constantIds.size(); i++)
+        modules.back() += "#" + std::to_string(module.constantIds[i]) + "=" + std::to_string(module.constantValues[i]);
+    }
+    cacheKey = cache.key(modules);
+    std::cout << "[I] specializing SPIR-V modules of " << sourcePaths.back() << std::endl;
+  } else {
+    cacheKey = compute ? cache.key({vertexCode}) : cache.key({vertexCode, fragmentCode});
+  }
+  ID = cache.load(cacheKey);
+  if(ID) {
+    linked = true;
+    return;
+  }
+
+  // 2. submit both stages and the link without querying any status, so the
+  // driver can compile in the background (GL_KHR_parallel_shader_compile)
+  // while the caller goes on loading data
+  ID = submit(vertexCode, fragmentCode, vertex, fragment);
+}
+
+unsigned int Shader::compileStage(GLenum type, size_t index, const std::string &code) const {
+  unsigned int shader = glCreateShader(type);
+  if(spirv.empty()) {
+    const char* source = code.c_str();
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
   }
-  const char* vShaderCode = vertexCode.c_str();
-  const char* fShaderCode = fragmentCode.c_str();
+  // specializing is the compile step of a SPIR-V stage, same status and log
+  const SpirvModule &module = spirv[index];
+  glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, module.words.data(), module.words.size() * 4);
+  glSpecializeShaderAny(shader, "main", module.constantIds.size(), module.constantIds.data(), module.constantValues.data());
+  return shader;
+}
+
+unsigned int Shader::submit(const std::string &vertexCode, const std::string &fragmentCode,
+                            unsigned int &vertexShader, unsigned int &fragmentShader) const {
+  // a compute program has its single stage in the vertex slot
+  vertexShader = compileStage(compute ? GL_COMPUTE_SHADER : GL_VERTEX_SHADER, 0, vertexCode);
+  fragmentShader = compute ? 0 : compileStage(GL_FRAGMENT_SHADER, 1, fragmentCode);
+
+  unsigned int program = glCreateProgram();
+  // ask the driver to keep a retrievable binary for the cache
+  glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  glAttachShader(program, vertexShader);
+  if(fragmentShader)
+    glAttachShader(program, fragmentShader);
+  glLinkProgram(program);
+  return program;
+}
+
+bool Shader::ready() {
+  if(linked)
+    return true;
+  // without the extension there is no way to ask, finishing will block
+  if(!GLEXT_parallel_shader_compile)
+    return true;
+
+  int done = 0;
+  glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+  return done;
+}
+
+void Shader::finish() {
+  if(linked)
+    return;
+  linked = true;
 
-  // 2. compile shaders
-  unsigned int vertex, fragment;
+  if(check(ID, vertex, fragment))
+    ProgramCache::instance().store(cacheKey, ID);
+  vertex = fragment = 0;
+}
+
+bool Shader::check(unsigned int program, unsigned int vertexShader, unsigned int fragmentShader) const {
   int success;
   char infoLog[512];
 
-  // vertex Shader
-  vertex = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertex, 1, &vShaderCode, NULL);
-  glCompileShader(vertex);
   // print compile errors if any
-  glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+  glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
   if(!success)
   {
-    glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+    std::cout << "ERROR::SHADER::" << (compute ? "COMPUTE" : "VERTEX") << "::COMPILATION_FAILED\n" << infoLog << std::endl;
   };
-
-  // fragment Shader
-  fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragment, 1, &fShaderCode, NULL);
-  glCompileShader(fragment);
-  // print compile errors if any
-  glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-  if(!success)
+  if(fragmentShader)
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+  if(fragmentShader && !success)
   {
-    glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+    glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
     std::cout << "ERROR::SHADER::fragment::COMPILATION_FAILED\n" << infoLog << std::endl;
   };
 
-    // shader Program
-  ID = glCreateProgram();
-  glAttachShader(ID, vertex);
-  glAttachShader(ID, fragment);
-  glLinkProgram(ID);
   // print linking errors if any
-  glGetProgramiv(ID, GL_LINK_STATUS, &success);
-  if(!success)
+  int linkStatus;
+  glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+  if(!linkStatus)
   {
-    glGetProgramInfoLog(ID, 512, NULL, infoLog);
+    glGetProgramInfoLog(program, 512, NULL, infoLog);
     std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
   }
 
   // delete the shaders as they're linked into our program now and no longer necessery
-  glDeleteShader(vertex);
-  glDeleteShader(fragment);
+  glDetachShader(program, vertexShader);
+  glDeleteShader(vertexShader);
+  if(fragmentShader) {
+    glDetachShader(program, fragmentShader);
+    glDeleteShader(fragmentShader);
+  }
+  return linkStatus;
+}
+
+bool Shader::rebuild() {
+  std::string vertexCode, fragmentCode;
+  // a file caught halfway through a save, the next event brings the rest
+  if(!readSources(vertexCode, fragmentCode))
+    return false;
 
+  unsigned int vertexShader, fragmentShader;
+  unsigned int program = submit(vertexCode, fragmentCode, vertexShader, fragmentShader);
+  if(!check(program, vertexShader, fragmentShader)) {
+    glDeleteProgram(program);
+    return false;
+  }
+  ProgramCache &cache = ProgramCache::instance();
+  // the embedded SPIR-V modules cannot have changed, their key stays
+  if(spirv.empty())
+    cache.store(compute ? cache.key({vertexCode}) : cache.key({vertexCode, fragmentCode}), program);
+  else
+    cache.store(cacheKey, program);
+
+  // the drawing context may only use the program once this context's
+  // commands on it are complete
+  GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  glDeleteSync(fence);
+
+  // a rebuild nobody drew with yet is simply superseded
+  unsigned int previous = replacement.exchange(program);
+  if(previous)
+    glDeleteProgram(previous);
+  return true;
 }
 
+unsigned int Shader::placeholder() {
+  // one per thread (one context per thread), tiny enough to compile synchronously
+  thread_local unsigned int program = 0;
+  if(program)
+    return program;
+
+  const char *vs =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "void main() { gl_Position = vec4(aPos, 1.0); }\n";
+  const char *fs =
+    "#version 330 core\n"
+    "out vec4 FragColor;\n"
+    "void main() { FragColor = vec4(0.5, 0.5, 0.5, 1.0); }\n";
+
+  unsigned int v = glCreateShader(GL_VERTEX_SHADER);
+  glShaderSource(v, 1, &vs, NULL);
+  glCompileShader(v);
+  unsigned int f = glCreateShader(GL_FRAGMENT_SHADER);
+  glShaderSource(f, 1, &fs, NULL);
+  glCompileShader(f);
+
+  program = glCreateProgram();
+  glAttachShader(program, v);
+  glAttachShader(program, f);
+  glLinkProgram(program);
+  glDeleteShader(v);
+  glDeleteShader(f);
+  return program;
+}
 
 void Shader::use() {
-  glUseProgram(ID);
+  // swap in a program rebuilt on another thread; the old one is deleted,
+  // so its pending build (if any) is waited on first
+  unsigned int rebuilt = replacement.exchange(0);
+  if(rebuilt) {
+    finish();
+    GLState::current().forgetProgram(ID);
+    glDeleteProgram(ID);
+    ID = rebuilt;
+    // new locations, and nothing uploaded to the new program yet
+    boundLayout = NULL;
+  }
+  // the placeholder cannot stand in for a dispatch, compute programs block
+  if(!linked && !compute && !ready()) {
+    GLState::current().useProgram(placeholder());
+    return;
+  }
+  finish();
+  GLState::current().useProgram(ID);
+}
+
+void Shader::setBool(const string &name, bool value) const {
+  setInt(name, value);
+}
+
+void Shader::setInt(const string &name, int value) const {
+  if(!linked)
+    return;
+  int location = glGetUniformLocation(this->ID, name.data());
+  glUniform1i(location, value);
 }
 
 void Shader::setFloat(const string &name, float value) const {
+  // the placeholder bound meanwhile has no uniforms
+  if(!linked)
+    return;
   int location = glGetUniformLocation(this->ID, name.data());
   glUniform1f(location, value);
-  cout << "Seting float for " << name << " to " << value << endl;
+}
+
+void Shader::setVec2(const string &name, float x, float y) const {
+  if(!linked)
+    return;
+  int location = glGetUniformLocation(this->ID, name.data());
+  glUniform2f(location, x, y);
+}
+
+void Shader::setMat4(const string &name, const float *value) const {
+  if(!linked)
+    return;
+  int location = glGetUniformLocation(this->ID, name.data());
+  glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+ShaderPermutations::ShaderPermutations(const char* vertexPath, const char* fragmentPath)
+  : vertexPath(vertexPath), fragmentPath(fragmentPath ? fragmentPath : "") {
+}
+
+Shader& ShaderPermutations::get(const ShaderDefines &defines) {
+  std::unique_ptr<Shader> &program = programs[defines];
+  if(!program) {
+    if(fragmentPath.empty())
+      program.reset(new Shader(vertexPath.c_str(), defines));
+    else
+      program.reset(new Shader(vertexPath.c_str(), fragmentPath.c_str(), defines));
+  }
+  return *program;
+}
+
+std::vector<Shader*> ShaderPermutations::built() const {
+  std::vector<Shader*> shaders;
+  for(const auto &program : programs)
+    shaders.push_back(program.second.get());
+  return shaders;
+}
+
+void Shader::bindUniforms(const UniformLayout &layout) {
+  boundLayout = &layout;
+  uniformLocations.assign(layout.count, -1);
+  uniformUploaded.assign(layout.count, false);
+  uniformValues.assign(layout.size, 0);
+
+  // a program that failed to link already reported its errors
+  int success;
+  glGetProgramiv(ID, GL_LINK_STATUS, &success);
+  if(!success)
+    return;
+
+  // SPIR-V programs have no uniform names to go by: member i is the
+  // uniform declared with layout (location = i)
+  if(!spirv.empty()) {
+    std::map<GLint, GLenum> active;
+    GLint count = 0;
+    glGetProgramInterfaceiv(ID, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+    for(GLint i = 0; i < count; i++) {
+      const GLenum props[2] = { GL_LOCATION, GL_TYPE };
+      GLint values[2];
+      glGetProgramResourceiv(ID, GL_UNIFORM, i, 2, props, 2, NULL, values);
+      active[values[0]] = values[1];
+    }
+    for(int i = 0; i < layout.count; i++) {
+      const UniformField &field = layout.fields[i];
+      std::map<GLint, GLenum>::const_iterator found = active.find(i);
+      if(found == active.end())
+        std::cout << "[I] " << layout.name << "::" << field.name << " (location " << i
+                  << ") is not an active uniform of " << sourcePaths.back() << std::endl;
+      else if(found->second != field.type)
+        std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << layout.name << "::" << field.name
+                  << " (location " << i << ") in " << sourcePaths.back() << std::endl;
+      else
+        uniformLocations[i] = i;
+    }
+    return;
+  }
+
+  std::map<std::string, GLenum> active;
+  GLint count = 0;
+  glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+  for(GLint i = 0; i < count; i++) {
+    char name[256];
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(ID, i, sizeof(name), NULL, &size, &type, name);
+    active[name] = type;
+  }
+
+  for(int i = 0; i < layout.count; i++) {
+    const UniformField &field = layout.fields[i];
+    std::map<std::string, GLenum>::const_iterator found = active.find(field.name);
+    // a typo, or a uniform this variant compiles out
+    if(found == active.end())
+      std::cout << "[I] " << layout.name << "::" << field.name << " is not an active uniform of "
+                << sourcePaths.back() << std::endl;
+    else if(found->second != field.type)
+      std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH " << layout.name << "::" << field.name
+                << " in " << sourcePaths.back() << std::endl;
+    else
+      uniformLocations[i] = glGetUniformLocation(ID, field.name);
+  }
+}
+
+void Shader::setUniforms(const UniformLayout &layout, const void *values) {
+  // the placeholder bound meanwhile has no uniforms
+  if(!linked)
+    return;
+  if(boundLayout != &layout)
+    bindUniforms(layout);
+
+  const unsigned char *bytes = (const unsigned char*) values;
+  for(int i = 0; i < layout.count; i++) {
+    const UniformField &field = layout.fields[i];
+    const void *value = bytes + field.offset;
+    unsigned char *last = uniformValues.data() + field.offset;
+    GLint location = uniformLocations[i];
+    if(location < 0 || (uniformUploaded[i] && memcmp(last, value, field.size) == 0))
+      continue;
+    memcpy(last, value, field.size);
+    uniformUploaded[i] = true;
+
+    // straight into the program object, whichever program is bound
+    switch(field.type) {
+      case GL_INT:        glProgramUniform1iv(ID, location, 1, (const GLint*) value); break;
+      case GL_FLOAT:      glProgramUniform1fv(ID, location, 1, (const GLfloat*) value); break;
+      case GL_FLOAT_VEC2: glProgramUniform2fv(ID, location, 1, (const GLfloat*) value); break;
+      case GL_FLOAT_VEC4: glProgramUniform4fv(ID, location, 1, (const GLfloat*) value); break;
+      case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(ID, location, 1, GL_FALSE, (const GLfloat*) value); break;
+    }
+  }
 }
@@ -0,0 +1,260 @@
+#include "shader_source.hpp"
+// generated by make from src/shaders: EMBEDDED_SHADERS
+#include "embedded_shaders.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static string& directory() {
+  static string dir = [] {
+    const char *env = getenv("LEARNOPENGL_SHADER_DIR");
+    return string(env ? env : "");
+  }();
+  return dir;
+}
+
+const string& shaderDirectory() {
+  return directory();
+}
+
+void setShaderDirectory(const string &dir) {
+  directory() = dir;
+}
+
+string shaderFile(const string &name) {
+  if(filesystem::path(name).is_absolute())
+    return name;
+  if(directory().empty())
+    return "";
+  return (filesystem::path(directory()) / name).string();
+}
+
+// whole file as a string, false (and an error printed) if it cannot be read
+static bool readSource(const string &name, string &source) {
+  string path = shaderFile(name);
+  if(path.empty()) {
+    for(const EmbeddedShader &shader : EMBEDDED_SHADERS)
+      if(name == shader.name) {
+        source = shader.source;
+        return true;
+      }
+    std::cout << "ERROR::SHADER::NOT_EMBEDDED " << name << std::endl;
+    return false;
+  }
+
+  std::ifstream file;
+  // ensure ifstream objects can throw exceptions:
+  file.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+  try
+  {
+    file.open(path);
+    std::stringstream stream;
+    stream << file.rdbuf();
+    file.close();
+    source = stream.str();
+    return true;
+  }
+  catch(std::ifstream::failure &e)
+  {
+    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+  }
+  return false;
+}
+
+// the directive on `line`, e.g. "include" for `  #include "x"`, empty for none
+static string directive(const string &line) {
+  size_t start = line.find_first_not_of(" \t");
+  if(start == string::npos || line[start] != '#')
+    return "";
+  start = line.find_first_not_of(" \t", start + 1);
+  if(start == string::npos)
+    return "";
+  size_t end = line.find_first_of(" \t\"<", start);
+  return line.substr(start, end == string::npos ? string::npos : end - start);
+}
+
+static string defineLines(const ShaderDefines &defines) {
+  string lines;
+  for(const auto &define : defines)
+    lines += "#define " + define.first + (define.second.empty() ? "" : " " + define.second) + "\n";
+  return lines;
+}
+
+// appends `path` expanded to `out`; `defines` are inserted after its #version
+// line and then cleared, they are only for the top file
+static bool expand(const string &path, const ShaderDefines *&defines, vector<string> &files, string &out) {
+  string source;
+  if(!readSource(path, source))
+    return false;
+  int index = files.size();
+  files.push_back(path);
+  filesystem::path dir = filesystem::path(path).parent_path();
+
+  istringstream lines(source);
+  string line;
+  int number = 0;
+  while(getline(lines, line)) {
+    number++;
+    string name = directive(line);
+    if(name == "include") {
+      size_t open = line.find('"');
+      size_t close = open == string::npos ? open : line.find('"', open + 1);
+      if(close == string::npos) {
+        std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << number << std::endl;
+        return false;
+      }
+      string included = (dir / line.substr(open + 1, close - open - 1)).lexically_normal().string();
+      if(find(files.begin(), files.end(), included) == files.end()) {
+        const ShaderDefines *none = NULL;
+        out += "#line 1 " + to_string(files.size()) + "\n";
+        if(!expand(included, none, files, out))
+          return false;
+      }
+      // back in this file
+      out += "#line " + to_string(number + 1) + " " + to_string(index) + "\n";
+      continue;
+    }
+
+    out += line + "\n";
+    if(name == "version" && defines) {
+      out += defineLines(*defines);
+      out += "#line " + to_string(number + 1) + " " + to_string(index) + "\n";
+      defines = NULL;
+    }
+  }
+  return true;
+}
+
+string preprocessShader(const string &path, const ShaderDefines &defines, vector<string> *files) {
+  vector<string> read;
+  const ShaderDefines *pending = defines.empty() ? NULL : &defines;
+  string out;
+  bool expanded = expand(filesystem::path(path).lexically_normal().string(), pending, read, out);
+  if(files)
+    *files = read;
+  if(!expanded)
+    return "";
+  // no #version line: the defines simply go first
+  if(pending)
+    out = defineLines(defines) + "#line 1 0\n" + out;
+  return out;
+}
+
+// the few SPIR-V opcodes and decorations specialize() looks at
+enum {
+  SPV_MAGIC = 0x07230203,
+  SPV_OP_NAME = 5,
+  SPV_OP_TYPE_FLOAT = 22,
+  SPV_OP_SPEC_CONSTANT_TRUE = 48,
+  SPV_OP_SPEC_CONSTANT_FALSE = 49,
+  SPV_OP_SPEC_CONSTANT = 50,
+  SPV_OP_DECORATE = 71,
+  SPV_DECORATION_SPEC_ID = 1
+};
+
+// `value` as the 32 bits of a constant: bool (0/1), float or integer
+static bool constantBits(const string &value, bool isBool, bool isFloat, unsigned int &bits) {
+  if(isBool) {
+    if(value.empty() || value == "1" || value == "true")
+      bits = 1;
+    else if(value == "0" || value == "false")
+      bits = 0;
+    else
+      return false;
+    return true;
+  }
+  char *end = NULL;
+  if(isFloat) {
+    float f = strtof(value.c_str(), &end);
+    memcpy(&bits, &f, sizeof(bits));
+  } else {
+    bits = (unsigned int) strtoll(value.c_str(), &end, 0);
+  }
+  return !value.empty() && *end == '\0';
+}
+
+// fills the module's constants from `defines`, reading the names, spec ids
+// and types of its specialization constants
+static bool specialize(const string &name, const ShaderDefines &defines, SpirvModule &module) {
+  const vector<uint32_t> &words = module.words;
+  if(words.size() < 5 || words[0] != SPV_MAGIC) {
+    std::cout << "ERROR::SHADER::BAD_SPIRV " << name << std::endl;
+    return false;
+  }
+
+  map<uint32_t, string> names;
+  map<uint32_t, uint32_t> specIds;
+  // result id -> opcode and result type of each specialization constant
+  map<uint32_t, pair<uint32_t, uint32_t>> constants;
+  vector<uint32_t> floatTypes;
+  for(size_t i = 5; i < words.size(); ) {
+    uint32_t count = words[i] >> 16, op = words[i] & 0xFFFF;
+    if(count == 0 || i + count > words.size()) {
+      std::cout << "ERROR::SHADER::BAD_SPIRV " << name << std::endl;
+      return false;
+    }
+    const uint32_t *operands = &words[i + 1];
+    if(op == SPV_OP_NAME && count > 2) {
+      const char *literal = (const char*) (operands + 1);
+      names[operands[0]] = string(literal, strnlen(literal, (count - 2) * 4));
+    } else if(op == SPV_OP_DECORATE && count > 3 && operands[1] == SPV_DECORATION_SPEC_ID) {
+      specIds[operands[0]] = operands[2];
+    } else if(op == SPV_OP_TYPE_FLOAT && count > 1) {
+      floatTypes.push_back(operands[0]);
+    } else if((op == SPV_OP_SPEC_CONSTANT_TRUE || op == SPV_OP_SPEC_CONSTANT_FALSE ||
+               op == SPV_OP_SPEC_CONSTANT) && count > 2) {
+      constants[operands[1]] = { op, operands[0] };
+    }
+    i += count;
+  }
+
+  for(const auto &spec : specIds) {
+    auto constant = constants.find(spec.first);
+    auto constantName = names.find(spec.first);
+    if(constant == constants.end() || constantName == names.end())
+      continue;
+    ShaderDefines::const_iterator define = defines.find(constantName->second);
+    if(define == defines.end())
+      continue;
+    bool isBool = constant->second.first != SPV_OP_SPEC_CONSTANT;
+    bool isFloat = find(floatTypes.begin(), floatTypes.end(), constant->second.second) != floatTypes.end();
+    unsigned int bits;
+    if(!constantBits(define->second, isBool, isFloat, bits)) {
+      std::cout << "ERROR::SHADER::BAD_SPECIALIZATION " << name << " " << define->first
+                << "=" << define->second << std::endl;
+      return false;
+    }
+    module.constantIds.push_back(spec.second);
+    module.constantValues.push_back(bits);
+  }
+  return true;
+}
+
+bool loadSpirv(const string &name, const ShaderDefines &defines, SpirvModule &module) {
+  if(!shaderFile(name).empty())
+    return false;
+  for(const EmbeddedSpirv &spirv : EMBEDDED_SPIRV)
+    if(spirv.name && name == spirv.name) {
+      module = SpirvModule();
+      module.words.assign(spirv.words, spirv.words + spirv.count);
+      return specialize(name, defines, module);
+    }
+  return false;
+}
+
+string describeDefines(const ShaderDefines &defines) {
+  string description;
+  for(const auto &define : defines) {
+    if(!description.empty())
+      description += ",";
+    description += define.first + (define.second.empty() ? "" : "=" + define.second);
+  }
+  return description;
+}
@@ -0,0 +1,110 @@
+#include "shader_watcher.hpp"
+
+#include <sys/inotify.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <filesystem>
+#include <iostream>
+
+// quiet time after the last write before rebuilding: editors save in
+// several steps (truncate and write, or write a copy and rename it over)
+static const int SETTLE_MS = 50;
+
+ShaderWatcher::ShaderWatcher(Context *context, const std::vector<Shader*> &shaders, std::function<void()> reloaded)
+  : context(context), reloaded(reloaded) {
+  notify = inotify_init1(IN_CLOEXEC);
+  if(notify < 0 || pipe2(quit, O_CLOEXEC) < 0) {
+    std::cout << "ERROR::SHADER_WATCHER::inotify unavailable, shaders are not watched" << std::endl;
+    if(notify >= 0)
+      close(notify);
+    notify = -1;
+    return;
+  }
+
+  // directories rather than files: a rename over the file would end a
+  // watch on the file itself
+  for(Shader *shader : shaders)
+    for(const std::string &name : shader->dependencies()) {
+      // compiled into the binary, nothing to watch
+      std::string path = shaderFile(name);
+      if(path.empty())
+        continue;
+      std::filesystem::path file(path);
+      std::string dir = file.has_parent_path() ? file.parent_path().string() : ".";
+      int wd = inotify_add_watch(notify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+      if(wd < 0) {
+        std::cout << "ERROR::SHADER_WATCHER::cannot watch " << dir << std::endl;
+        continue;
+      }
+      std::vector<Shader*> &users = files[{wd, file.filename().string()}];
+      if(std::find(users.begin(), users.end(), shader) == users.end())
+        users.push_back(shader);
+    }
+  std::cout << "Watching " << files.size() << " shader files" << std::endl;
+  thread = std::thread(&ShaderWatcher::run, this);
+}
+
+ShaderWatcher::~ShaderWatcher() {
+  if(notify < 0)
+    return;
+  char byte = 0;
+  if(write(quit[1], &byte, 1) == 1 && thread.joinable())
+    thread.join();
+  close(notify);
+  close(quit[0]);
+  close(quit[1]);
+}
+
+void ShaderWatcher::run() {
+  context->makeCurrent();
+  std::vector<Shader*> changed;
+  alignas(inotify_event) char buffer[4096];
+  while(true) {
+    pollfd fds[2] = { { notify, POLLIN, 0 }, { quit[0], POLLIN, 0 } };
+    // sleep until a file is written, then until the writes settle
+    int ready = poll(fds, 2, changed.empty() ? -1 : SETTLE_MS);
+    if(ready < 0 && errno == EINTR)
+      continue;
+    if(ready < 0 || fds[1].revents)
+      break;
+    if(ready == 0) {
+      rebuild(changed);
+      changed.clear();
+      continue;
+    }
+
+    ssize_t length = read(notify, buffer, sizeof(buffer));
+    for(ssize_t offset = 0; offset < length; ) {
+      const inotify_event *event = (const inotify_event*) (buffer + offset);
+      offset += sizeof(inotify_event) + event->len;
+      if(!event->len)
+        continue;
+      auto found = files.find({event->wd, std::string(event->name)});
+      if(found == files.end())
+        continue;
+      for(Shader *shader : found->second)
+        if(std::find(changed.begin(), changed.end(), shader) == changed.end())
+          changed.push_back(shader);
+    }
+  }
+  context->doneCurrent();
+}
+
+void ShaderWatcher::rebuild(const std::vector<Shader*> &changed) {
+  bool replaced = false;
+  for(Shader *shader : changed) {
+    std::string name = shader->paths().back();
+    if(shader->rebuild()) {
+      std::cout << "Reloaded " << name << std::endl;
+      replaced = true;
+    } else {
+      std::cout << "Kept the previous program for " << name << std::endl;
+    }
+  }
+  if(replaced && reloaded)
+    reloaded();
+}
@@ -0,0 +1,22 @@
+#version 420 core
+
+noperspective in vec2 dist;
+flat in float len;
+out vec4 FragColor;
+
+#include "map_color.glsl"
+
+uniform float width = 1.0;
+uniform float c = 0.0;
+
+void main()
+{
+  // distance to the segment (square caps), coverage of a 1px wide pixel
+  float beyond = max(-dist.y, dist.y - len);
+  float d = max(abs(dist.x), beyond);
+  float coverage = clamp(width * 0.5 + 0.5 - d, 0.0, 1.0);
+  if(coverage <= 0.0)
+    discard;
+
+  FragColor = vec4(mapColor(c), coverage);
+}
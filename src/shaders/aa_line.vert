@@ -0,0 +1,42 @@
+#version 420 core
+
+// One instance per segment, expanded into a screen aligned quad 1px wider
+// than the line on every side so the fragment shader can fade the edges.
+layout (location = 0) in int start;
+// the map's vertex buffer, segment = (start, start + 1)
+layout (binding = 0) uniform samplerBuffer points;
+
+uniform mat4 view = mat4(1.0);
+// framebuffer size in pixels
+uniform vec2 viewport = vec2(512.0);
+// line width in pixels
+uniform float width = 1.0;
+
+// x: distance across the line, y: distance along it from p0, in pixels
+noperspective out vec2 dist;
+flat out float len;
+
+#include "screen.glsl"
+
+void main()
+{
+  vec4 c0 = view * vec4(texelFetch(points, start).xy, 0.0, 1.0);
+  vec4 c1 = view * vec4(texelFetch(points, start + 1).xy, 0.0, 1.0);
+  vec2 s0 = toScreen(c0, viewport);
+  vec2 s1 = toScreen(c1, viewport);
+
+  vec2 d = s1 - s0;
+  len = length(d);
+  vec2 dir = len > 0.0 ? d / len : vec2(1.0, 0.0);
+  vec2 normal = vec2(-dir.y, dir.x);
+  float extent = width * 0.5 + 1.0;
+
+  // triangle strip: (p0,-) (p0,+) (p1,-) (p1,+)
+  float side = (gl_VertexID & 1) == 0 ? -1.0 : 1.0;
+  bool end = gl_VertexID >= 2;
+  float along = end ? len + extent : -extent;
+  vec2 s = s0 + dir * along + normal * side * extent;
+
+  dist = vec2(side * extent, along);
+  gl_Position = fromScreen(s, c0.z, viewport);
+}
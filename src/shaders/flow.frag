@@ -0,0 +1,15 @@
+#version 420 core
+
+noperspective in float across;
+flat in float halfWidth;
+flat in float alpha;
+out vec4 FragColor;
+
+void main()
+{
+  // analytic edge coverage, like aa_line.frag
+  float coverage = clamp(halfWidth + 0.5 - abs(across), 0.0, 1.0);
+  if(coverage <= 0.0)
+    discard;
+  FragColor = vec4(0.3f, 0.8f, 1.0f, alpha * coverage);
+}
@@ -0,0 +1,52 @@
+#version 420 core
+
+// One instance per OD pair: a quadratic bezier from the origin's centroid to
+// the destination's, tessellated into a triangle strip along gl_VertexID
+layout (location = 0) in ivec2 od;
+layout (location = 1) in float volume;
+// zone centroids, normalized map space
+layout (binding = 0) uniform samplerBuffer centroids;
+
+uniform mat4 view = mat4(1.0);
+uniform vec2 viewport = vec2(512.0);
+uniform float segments = 16.0;
+uniform float curvature = 0.2;
+// pixel width of the smallest and largest flow
+uniform vec2 widthRange = vec2(0.5, 8.0);
+uniform float maxVolume = 1.0;
+
+noperspective out float across;
+flat out float halfWidth;
+flat out float alpha;
+
+#include "screen.glsl"
+
+void main()
+{
+  vec2 a = texelFetch(centroids, od.x).xy;
+  vec2 b = texelFetch(centroids, od.y).xy;
+  vec2 chord = b - a;
+  vec2 control = (a + b) * 0.5 + vec2(chord.y, -chord.x) * curvature;
+
+  float t = float(gl_VertexID >> 1) / segments;
+  float side = (gl_VertexID & 1) == 0 ? -1.0 : 1.0;
+  vec2 p = mix(mix(a, control, t), mix(control, b, t), t);
+  vec2 tangent = mix(control - a, b - control, t);
+
+  // expand in pixels, so flows keep their width whatever the zoom
+  vec4 clip = view * vec4(p, 0.0, 1.0);
+  vec2 screen = toScreen(clip, viewport);
+  vec2 dir = mat2(view) * tangent * viewport;
+  dir = dot(dir, dir) > 0.0 ? normalize(dir) : vec2(1.0, 0.0);
+  vec2 normal = vec2(-dir.y, dir.x);
+
+  // square root: area of the line grows with the volume
+  float v = sqrt(clamp(volume / maxVolume, 0.0, 1.0));
+  halfWidth = mix(widthRange.x, widthRange.y, v) * 0.5;
+  alpha = mix(0.2, 0.9, v);
+  float extent = halfWidth + 1.0;
+  across = side * extent;
+  screen += normal * across;
+
+  gl_Position = fromScreen(screen, 0.0, viewport);
+}
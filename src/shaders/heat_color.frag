@@ -0,0 +1,24 @@
+#version 430 core
+
+layout (binding = 0) uniform sampler2D density;
+layout (std430, binding = 0) readonly buffer Max { uint maxBits; };
+out vec4 FragColor;
+
+// transparent -> blue -> cyan -> yellow -> red
+vec3 ramp(float t)
+{
+  vec3 c = mix(vec3(0.0, 0.2, 1.0), vec3(0.0, 1.0, 1.0), clamp(t * 3.0, 0.0, 1.0));
+  c = mix(c, vec3(1.0, 1.0, 0.0), clamp(t * 3.0 - 1.0, 0.0, 1.0));
+  return mix(c, vec3(1.0, 0.0, 0.0), clamp(t * 3.0 - 2.0, 0.0, 1.0));
+}
+
+void main()
+{
+  float m = uintBitsToFloat(maxBits);
+  float d = texelFetch(density, ivec2(gl_FragCoord.xy), 0).r;
+  if(m <= 0.0 || d <= 0.0)
+    discard;
+  // square root keeps the sparse areas visible next to the peaks
+  float t = sqrt(d / m);
+  FragColor = vec4(ramp(t), smoothstep(0.0, 0.15, t) * 0.85);
+}
@@ -0,0 +1,8 @@
+#version 420 core
+
+// fullscreen triangle, no vertex data
+void main()
+{
+  vec2 p = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;
+  gl_Position = vec4(p, 0.0, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 420 core
+
+in vec2 offset;
+flat in float weight;
+out vec4 FragColor;
+
+void main()
+{
+  // smooth compact kernel, (1 - r^2)^2, summed by additive blending
+  float r2 = dot(offset, offset);
+  if(r2 >= 1.0)
+    discard;
+  float k = 1.0 - r2;
+  FragColor = vec4(weight * k * k);
+}
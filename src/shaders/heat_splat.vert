@@ -0,0 +1,20 @@
+#version 420 core
+
+// One instance per point: a quad of `radius` pixels around it
+layout (location = 0) in vec3 point;
+
+uniform mat4 view = mat4(1.0);
+uniform vec2 viewport = vec2(512.0);
+uniform float radius = 24.0;
+
+// position in the kernel, unit circle
+out vec2 offset;
+flat out float weight;
+
+void main()
+{
+  offset = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+  weight = point.z;
+  vec4 clip = view * vec4(point.xy, 0.0, 1.0);
+  gl_Position = vec4(clip.xy + offset * radius * 2.0 / viewport, 0.0, 1.0);
+}
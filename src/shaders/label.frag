@@ -0,0 +1,23 @@
+#version 420 core
+
+in vec2 uv;
+out vec4 FragColor;
+
+layout (binding = 0) uniform sampler2D atlas;
+// font units between the stroke edge (0.5) and 0 or 1
+uniform float spread = 1.5;
+
+void main()
+{
+  float d = texture(atlas, uv).r;
+  // about one pixel of smoothing whatever the scale
+  float w = max(fwidth(d), 1e-4) * 0.75;
+  float text = smoothstep(0.5 - w, 0.5 + w, d);
+  // dark halo, keeps labels readable over any fill
+  float edge = 0.5 - 0.8 / (2.0 * spread);
+  float halo = smoothstep(edge - w, edge + w, d);
+  float alpha = max(text, halo * 0.75);
+  if(alpha <= 0.0)
+    discard;
+  FragColor = vec4(mix(vec3(0.05), vec3(1.0), text / max(alpha, 1e-4)), alpha);
+}
@@ -0,0 +1,47 @@
+#version 420 core
+
+// One instance per glyph: a quad over the glyph's atlas cell, placed in
+// pixels around the label's anchor
+layout (location = 0) in vec2 anchor;
+// pen position of the glyph's origin relative to the anchor, font units
+layout (location = 1) in vec2 offset;
+// atlas cell, label
+layout (location = 2) in ivec2 glyph;
+// 0 for the labels the placer hid
+layout (binding = 1) uniform usamplerBuffer visible;
+
+uniform mat4 view = mat4(1.0);
+uniform vec2 viewport = vec2(512.0);
+// pixels per font unit
+uniform float unitPixels = 2.0;
+// atlas layout, see GlyphAtlas
+uniform int columns = 16;
+uniform vec2 cell;
+uniform vec2 atlasSize;
+uniform float texelsPerUnit;
+uniform float padding;
+
+out vec2 uv;
+
+#include "screen.glsl"
+
+void main()
+{
+  if(texelFetch(visible, glyph.y).r == 0u) {
+    // degenerate quad, nothing is rasterized
+    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    uv = vec2(0.0);
+    return;
+  }
+  vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+  vec2 cellOrigin = vec2(glyph.x % columns, glyph.x / columns) * cell;
+  uv = (cellOrigin + corner * cell) / atlasSize;
+
+  // whole pixel anchors, so text does not shimmer while panning
+  vec4 clip = view * vec4(anchor, 0.0, 1.0);
+  vec2 screen = floor(toScreen(clip, viewport) + 0.5);
+  vec2 local = corner * cell / texelsPerUnit - padding;
+  screen += (offset + local) * unitPixels;
+
+  gl_Position = fromScreen(screen, 0.0, viewport);
+}
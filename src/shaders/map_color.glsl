@@ -0,0 +1,5 @@
+// Colors of the map layer: c = 1 fills the zones, c = 0 draws the outlines
+vec3 mapColor(float c)
+{
+  return c == 1.0 ? vec3(1.0, 0.5, 0.2) : vec3(0.0);
+}
@@ -1,13 +1,20 @@
-#version 420 core
+#version 430 core
 
+// Explicit uniform and varying locations: besides GLSL source this file is
+// compiled to SPIR-V (make spirv), which has no names to link by.
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
+// shape index of the vertex, for picking
+layout (location = 2) in uint aZone;
 
-out vec3 colour;
-uniform float sinVal = 1.0;
+layout (location = 0) out vec3 colour;
+layout (location = 1) flat out uint zone;
+// maps the layer-local map space to clip space (tiles, Camera)
+layout (location = 0) uniform mat4 view;
 
 void main()
 {
-  colour = aColor*sinVal;
-  gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);
-};
+  colour = aColor;
+  zone = aZone;
+  gl_Position = view * vec4(aPos.x, aPos.y, aPos.z, 1.0);
+}
@@ -0,0 +1,14 @@
+// Conversions between clip space and framebuffer pixels, for layers that
+// size their geometry in pixels whatever the zoom
+
+// pixel position of a clip space point, origin at the bottom left
+vec2 toScreen(vec4 clip, vec2 viewport)
+{
+  return (clip.xy * 0.5 + 0.5) * viewport;
+}
+
+// clip space position of a pixel position at depth z
+vec4 fromScreen(vec2 screen, float z, vec2 viewport)
+{
+  return vec4(screen / viewport * 2.0 - 1.0, z, 1.0);
+}
@@ -1,13 +1,44 @@
-#version 420 core
+#version 430 core
 
-out vec4 FragColor;
-uniform float c = 1.0;
+// Map fill and outline colors (map_color.glsl). Variants:
+//   VERTEX_COLOR  the per-vertex color of points.vert instead
+//   PICK_IDS      also writes the zone id, see MapRenderer::pickIds
+// From GLSL source they are defines, from SPIR-V (make spirv) the
+// specialization constants of the same names.
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+layout (constant_id = 0) const bool VERTEX_COLOR = false;
+layout (constant_id = 1) const bool PICK_IDS = false;
+#else
+#ifdef VERTEX_COLOR
+#undef VERTEX_COLOR
+#define VERTEX_COLOR true
+#else
+#define VERTEX_COLOR false
+#endif
+#ifdef PICK_IDS
+#undef PICK_IDS
+#define PICK_IDS true
+#else
+#define PICK_IDS false
+#endif
+#endif
+#include "map_color.glsl"
+
+layout (location = 0) in vec3 colour;
+layout (location = 1) flat in uint zone;
+layout (location = 0) out vec4 FragColor;
+// picking attachment
+layout (location = 1) out uint ZoneId;
+// MapUniforms, after points.vert's view
+layout (location = 1) uniform float c;
 
 void main()
 {
-	if(c == 1){
-		FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);
-	}else {
-		FragColor = vec4(0.0f, 0.0f, 0.0f, 1.0f);
-	}
-};
+  if(VERTEX_COLOR)
+    FragColor = vec4(colour, 1.0f);
+  else
+    FragColor = vec4(mapColor(c), 1.0f);
+  if(PICK_IDS)
+    ZoneId = zone + 1u;
+}
@@ -0,0 +1,426 @@
+// shpgen: writes a synthetic polygon shapefile (.shp, .shx and .dbf), so
+// loader, triangulation and rendering runs can be reproduced without the
+// survey's zone files.
+//
+//   shpgen --output <base> [--zones N] [--vertices V] [--parts P] [--holes H]
+//          [--concavity 0-1] [--seed S] [--bbox minX,minY,maxX,maxY]
+//
+// Zones tile the bbox as the Voronoi cells of a jittered grid. Every edge
+// is split into points about bbox-perimeter/V apart (so outer rings have
+// about V vertices) and, between two zones, bent sideways by up to
+// `concavity` of the room it has; an edge is generated from its two sites
+// alone, so both zones get exactly the same points and the tessellation has
+// no gaps or overlaps. Each record is made of P cells (scattered, P > 1 is
+// a multipart zone), each with H holes around its site. The grid can have
+// up to a row more cells than N*P; those join the record of a neighboring
+// cell as one more part, so the zones always cover the whole bbox. Outer rings are
+// clockwise and holes counter-clockwise, all closed, as shapefiles want.
+// The same options and seed always write the same files.
+//
+// The .dbf has ZONE (1-based record number), NAME and AREA (in bbox units).
+
+#include <shapefil.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// edge labels that are not a neighbor's cell index: the bbox sides, and the
+// sides of the starting square that the neighbors have to clip away
+enum { LEFT = -1, RIGHT = -2, BOTTOM = -3, TOP = -4, OPEN = -5 };
+
+// sites move up to this much of a cell from the cell center, which keeps a
+// Voronoi cell inside the REACH cells around its own
+static const double JITTER = 0.4;
+static const int REACH = 2;
+
+struct Point
+{
+  double x, y;
+};
+
+// splitmix64: the same numbers on every platform and compiler, unlike the
+// <random> distributions
+static uint64_t mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// uniform in [0, 1), a pure function of the seed and the integers
+static double random01(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0) {
+  uint64_t h = mix(mix(mix(mix(seed) ^ a) ^ b) ^ c);
+  return (h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// in [-1, 1)
+static double random11(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0) {
+  return 2 * random01(seed, a, b, c) - 1;
+}
+
+// twice the signed area, negative for clockwise rings
+static double ringArea(const Point *ring, size_t count) {
+  double area = 0;
+  for(size_t i = 0; i + 1 < count; i++)
+    area += ring[i].x * ring[i + 1].y - ring[i + 1].x * ring[i].y;
+  return area;
+}
+
+struct Generator
+{
+  double bbox[4] = { 0.0, 0.0, 1.0, 1.0 };
+  uint64_t seed = 1;
+  // target vertex count of the outer rings
+  int vertices = 32;
+  double concavity = 0.3;
+  int holes = 0;
+
+  int cols = 1, rows = 1;
+  double cellWidth = 1.0, cellHeight = 1.0;
+  // distance between the points added along the edges
+  double spacing = 1.0;
+
+  // a grid of about square cells, at least `cells` of them
+  void layout(int cells) {
+    double width = bbox[2] - bbox[0], height = bbox[3] - bbox[1];
+    cols = std::max(1, (int) std::lround(std::sqrt(cells * width / height)));
+    rows = (cells + cols - 1) / cols;
+    cellWidth = width / cols;
+    cellHeight = height / rows;
+    // a jittered grid's Voronoi cell has about the perimeter of a square cell
+    spacing = 3.9 * std::sqrt(cellWidth * cellHeight) / vertices;
+  }
+
+  Point site(int cell) const {
+    int i = cell % cols, j = cell / cols;
+    return { bbox[0] + (i + 0.5 + JITTER * random11(seed, cell, 1)) * cellWidth,
+             bbox[1] + (j + 0.5 + JITTER * random11(seed, cell, 2)) * cellHeight };
+  }
+
+  // clips the convex cell to the half plane closer to `s` than to the
+  // site of `neighbor`, the new edge gets the neighbor as label
+  void clip(std::vector<Point> &points, std::vector<int> &labels, Point s, int neighbor) const {
+    Point t = site(neighbor);
+    Point m = { (s.x + t.x) / 2, (s.y + t.y) / 2 };
+    auto side = [&](const Point &p) { return (p.x - m.x) * (t.x - s.x) + (p.y - m.y) * (t.y - s.y); };
+
+    std::vector<Point> clippedPoints;
+    std::vector<int> clippedLabels;
+    size_t n = points.size();
+    for(size_t i = 0; i < n; i++) {
+      const Point &p = points[i], &q = points[(i + 1) % n];
+      double fp = side(p), fq = side(q);
+      if(fp <= 0) {
+        clippedPoints.push_back(p);
+        clippedLabels.push_back(labels[i]);
+      }
+      if((fp <= 0) != (fq <= 0)) {
+        double a = fp / (fp - fq);
+        clippedPoints.push_back({ p.x + a * (q.x - p.x), p.y + a * (q.y - p.y) });
+        // leaving the half plane, the way back in runs along the bisector
+        clippedLabels.push_back(fp <= 0 ? neighbor : labels[i]);
+      }
+    }
+    points.swap(clippedPoints);
+    labels.swap(clippedLabels);
+  }
+
+  // where the lines of edge labels `a` and `b` of `cell` meet, computed
+  // from the sites in index order so that every cell sharing the corner
+  // gets the same bits; `clipped` when a label is OPEN
+  Point corner(int cell, int a, int b, Point clipped) const {
+    if(a == OPEN || b == OPEN)
+      return clipped;
+    if(a < 0 && b < 0)
+      return { (a == LEFT || b == LEFT) ? bbox[0] : bbox[2],
+               (a == BOTTOM || b == BOTTOM) ? bbox[1] : bbox[3] };
+    if(a < 0 || b < 0) {
+      int neighbor = std::max(a, b), bound = std::min(a, b);
+      Point s = site(std::min(cell, neighbor)), t = site(std::max(cell, neighbor));
+      Point m = { (s.x + t.x) / 2, (s.y + t.y) / 2 };
+      if(bound == LEFT || bound == RIGHT) {
+        double x = bound == LEFT ? bbox[0] : bbox[2];
+        return { x, m.y - (x - m.x) * (t.x - s.x) / (t.y - s.y) };
+      }
+      double y = bound == BOTTOM ? bbox[1] : bbox[3];
+      return { m.x - (y - m.y) * (t.y - s.y) / (t.x - s.x), y };
+    }
+    // circumcenter of the three sites
+    int ids[3] = { cell, a, b };
+    std::sort(ids, ids + 3);
+    Point p = site(ids[0]), q = site(ids[1]), r = site(ids[2]);
+    double bx = q.x - p.x, by = q.y - p.y, cx = r.x - p.x, cy = r.y - p.y;
+    double d = 2 * (bx * cy - by * cx);
+    double b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+    return { p.x + (cy * b2 - by * c2) / d, p.y + (bx * c2 - cx * b2) / d };
+  }
+
+  // Voronoi cell of `cell`, clockwise; labels[i] is what lies across the
+  // edge from points[i] to the next point. False if the cell kept a side
+  // of the starting square (not expected with JITTER < 0.5).
+  bool voronoi(int cell, std::vector<Point> &points, std::vector<int> &labels) const {
+    int i = cell % cols, j = cell / cols;
+    bool left = i - REACH <= 0, right = i + REACH >= cols - 1;
+    bool bottom = j - REACH <= 0, top = j + REACH >= rows - 1;
+    double x0 = left ? bbox[0] : bbox[0] + (i - REACH) * cellWidth;
+    double x1 = right ? bbox[2] : bbox[0] + (i + 1 + REACH) * cellWidth;
+    double y0 = bottom ? bbox[1] : bbox[1] + (j - REACH) * cellHeight;
+    double y1 = top ? bbox[3] : bbox[1] + (j + 1 + REACH) * cellHeight;
+    points = { { x0, y1 }, { x1, y1 }, { x1, y0 }, { x0, y0 } };
+    labels = { top ? TOP : OPEN, right ? RIGHT : OPEN, bottom ? BOTTOM : OPEN, left ? LEFT : OPEN };
+
+    Point s = site(cell);
+    for(int dj = -REACH; dj <= REACH; dj++)
+      for(int di = -REACH; di <= REACH; di++) {
+        int ni = i + di, nj = j + dj;
+        if((di || dj) && ni >= 0 && ni < cols && nj >= 0 && nj < rows)
+          clip(points, labels, s, nj * cols + ni);
+      }
+
+    size_t n = points.size();
+    std::vector<Point> corners(n);
+    for(size_t k = 0; k < n; k++)
+      corners[k] = corner(cell, labels[(k + n - 1) % n], labels[k], points[k]);
+    points.clear();
+    std::vector<int> kept;
+    for(size_t k = 0; k < n; k++) {
+      // an edge too short to survive the exact corners
+      if(!points.empty() && corners[k].x == points.back().x && corners[k].y == points.back().y) {
+        kept.back() = labels[k];
+        continue;
+      }
+      points.push_back(corners[k]);
+      kept.push_back(labels[k]);
+    }
+    if(points.size() > 1 && points.back().x == points[0].x && points.back().y == points[0].y) {
+      points.pop_back();
+      kept.pop_back();
+    }
+    labels.swap(kept);
+    return std::find(labels.begin(), labels.end(), OPEN) == labels.end();
+  }
+
+  // appends the points strictly between a and b on the edge labeled `label`
+  // of `cell`; the neighbor across gets the same points in reverse
+  void edgePoints(int cell, int label, Point a, Point b, std::vector<Point> &out) const {
+    bool forward = a.x < b.x || (a.x == b.x && a.y < b.y);
+    Point p = forward ? a : b, q = forward ? b : a;
+    double dx = q.x - p.x, dy = q.y - p.y;
+    double length = std::hypot(dx, dy);
+    int count = std::max(0, (int) std::lround(length / spacing) - 1);
+    if(!count)
+      return;
+
+    // a smooth bend, flat at both corners so neighboring edges do not cross
+    double amplitude = 0, r1 = 0, r2 = 0;
+    if(label >= 0 && concavity > 0) {
+      int lo = std::min(cell, label), hi = std::max(cell, label);
+      Point s = site(lo), t = site(hi);
+      amplitude = concavity * std::min(std::hypot(t.x - s.x, t.y - s.y), length) / 8;
+      r1 = random11(seed, lo, hi, 3);
+      r2 = random11(seed, lo, hi, 4);
+    }
+
+    size_t first = out.size();
+    for(int k = 1; k <= count; k++) {
+      double t = (double) k / (count + 1);
+      double bend = std::sin(M_PI * t);
+      double offset = amplitude * bend * bend * (r1 + r2 * std::sin(2 * M_PI * t));
+      out.push_back({ p.x + t * dx - offset * dy / length, p.y + t * dy + offset * dx / length });
+    }
+    if(!forward)
+      std::reverse(out.begin() + first, out.end());
+  }
+
+  // room around the site no edge of its cell can reach
+  double clearance(int cell) const {
+    Point s = site(cell);
+    double room = std::min(std::min(s.x - bbox[0], bbox[2] - s.x), std::min(s.y - bbox[1], bbox[3] - s.y));
+    int i = cell % cols, j = cell / cols;
+    for(int dj = -REACH; dj <= REACH; dj++)
+      for(int di = -REACH; di <= REACH; di++) {
+        int ni = i + di, nj = j + dj;
+        if((di || dj) && ni >= 0 && ni < cols && nj >= 0 && nj < rows) {
+          Point t = site(nj * cols + ni);
+          // half way to the neighbor, less the most an edge bends
+          room = std::min(room, std::hypot(t.x - s.x, t.y - s.y) / 2 * (1 - concavity / 2));
+        }
+      }
+    return room;
+  }
+
+  // appends the rings of one cell (the outer ring, then its holes) and their
+  // starts; returns the cell's area
+  double cellRings(int cell, std::vector<Point> &points, std::vector<int> &starts, bool &open) const {
+    std::vector<Point> corners;
+    std::vector<int> labels;
+    if(!voronoi(cell, corners, labels))
+      open = true;
+
+    starts.push_back(points.size());
+    size_t first = points.size();
+    for(size_t k = 0; k < corners.size(); k++) {
+      points.push_back(corners[k]);
+      edgePoints(cell, labels[k], corners[k], corners[(k + 1) % corners.size()], points);
+    }
+    points.push_back(corners[0]);
+    double area = -ringArea(&points[first], points.size() - first);
+
+    if(holes > 0) {
+      Point s = site(cell);
+      double room = clearance(cell);
+      // one hole on the site, more on a circle around it, none touching
+      double ring = holes == 1 ? 0.0 : 0.5 * room;
+      double radius = holes == 1 ? 0.5 * room : std::min(0.4 * room, 0.45 * room * std::sin(M_PI / holes));
+      int sides = std::max(3, vertices / 4);
+      double phase = 2 * M_PI * random01(seed, cell, 5);
+      for(int h = 0; h < holes; h++) {
+        double angle = phase + 2 * M_PI * h / holes;
+        Point center = { s.x + ring * std::cos(angle), s.y + ring * std::sin(angle) };
+        starts.push_back(points.size());
+        first = points.size();
+        for(int k = 0; k <= sides; k++) {
+          double a = angle + 2 * M_PI * (k % sides) / sides;
+          points.push_back({ center.x + radius * std::cos(a), center.y + radius * std::sin(a) });
+        }
+        area -= ringArea(&points[first], points.size() - first);
+      }
+    }
+    return area / 2;
+  }
+};
+
+int main(int argc, char** argv)
+{
+  std::string output;
+  Generator generator;
+  int zones = 1000;
+  int parts = 1;
+  bool usage = false;
+
+  for(int i=1; i<argc; i++) {
+    std::string arg(argv[i]);
+    if(arg == "--output" && i+1 < argc)
+      output = argv[++i];
+    else if(arg == "--zones" && i+1 < argc)
+      zones = std::max(1, atoi(argv[++i]));
+    else if(arg == "--vertices" && i+1 < argc)
+      generator.vertices = std::max(3, atoi(argv[++i]));
+    else if(arg == "--parts" && i+1 < argc)
+      parts = std::max(1, atoi(argv[++i]));
+    else if(arg == "--holes" && i+1 < argc)
+      generator.holes = std::max(0, atoi(argv[++i]));
+    else if(arg == "--concavity" && i+1 < argc)
+      generator.concavity = std::max(0.0, std::min(1.0, atof(argv[++i])));
+    else if(arg == "--seed" && i+1 < argc)
+      generator.seed = strtoull(argv[++i], NULL, 10);
+    else if(arg == "--bbox" && i+1 < argc) {
+      double *b = generator.bbox;
+      usage = usage || sscanf(argv[++i], "%lf,%lf,%lf,%lf", &b[0], &b[1], &b[2], &b[3]) != 4 || b[2] <= b[0] || b[3] <= b[1];
+    }
+    else
+      usage = true;
+  }
+  if(usage || output.empty()) {
+    std::cout << "usage: shpgen --output <base> [--zones N] [--vertices V] [--parts P] [--holes H]"
+                 " [--concavity 0-1] [--seed S] [--bbox minX,minY,maxX,maxY]" << std::endl;
+    return -1;
+  }
+
+  // cells in record order; scattered when records have several parts
+  int cells = zones * parts;
+  generator.layout(cells);
+  int cols = generator.cols, rows = generator.rows, grid = cols * rows;
+  std::vector<int> order(grid);
+  for(size_t i = 0; i < order.size(); i++)
+    order[i] = i;
+  if(parts > 1)
+    for(size_t i = order.size() - 1; i > 0; i--)
+      std::swap(order[i], order[(size_t) (random01(generator.seed, i, 6) * (i + 1))]);
+
+  // the cells of each record: its P cells, then the leftover cells (past
+  // N*P in `order`) that took it from a grid neighbor, below first
+  std::vector<std::vector<int>> recordCells(zones);
+  std::vector<int> owner(grid, -1);
+  for(int k = 0; k < cells; k++) {
+    owner[order[k]] = k / parts;
+    recordCells[k / parts].push_back(order[k]);
+  }
+  for(bool changed = true; changed; ) {
+    changed = false;
+    for(int k = cells; k < grid; k++) {
+      int c = order[k], i = c % cols, j = c / cols;
+      int neighbors[4] = { j > 0 ? c - cols : -1, i > 0 ? c - 1 : -1,
+                           i + 1 < cols ? c + 1 : -1, j + 1 < rows ? c + cols : -1 };
+      for(int n : neighbors)
+        if(owner[c] < 0 && n >= 0 && owner[n] >= 0) {
+          owner[c] = owner[n];
+          recordCells[owner[c]].push_back(c);
+          changed = true;
+        }
+    }
+  }
+
+  SHPHandle shp = SHPCreate(output.c_str(), SHPT_POLYGON);
+  DBFHandle dbf = DBFCreate(output.c_str());
+  if(shp == NULL || dbf == NULL) {
+    std::cout << "ERROR::SHPGEN::cannot create " << output << std::endl;
+    return -1;
+  }
+  int zoneField = DBFAddField(dbf, "ZONE", FTInteger, 10, 0);
+  int nameField = DBFAddField(dbf, "NAME", FTString, 32, 0);
+  int areaField = DBFAddField(dbf, "AREA", FTDouble, 20, 10);
+
+  auto start = std::chrono::steady_clock::now();
+  long long total = 0, outer = 0;
+  int openCells = 0;
+  std::vector<Point> points;
+  std::vector<int> starts;
+  std::vector<double> x, y;
+  for(int record = 0; record < zones; record++) {
+    points.clear();
+    starts.clear();
+    double area = 0;
+    for(int cell : recordCells[record]) {
+      bool open = false;
+      size_t first = points.size();
+      area += generator.cellRings(cell, points, starts, open);
+      outer += (generator.holes ? starts[starts.size() - generator.holes] : points.size()) - first;
+      openCells += open;
+    }
+
+    x.resize(points.size());
+    y.resize(points.size());
+    for(size_t i = 0; i < points.size(); i++) {
+      x[i] = points[i].x;
+      y[i] = points[i].y;
+    }
+    SHPObject *obj = SHPCreateObject(SHPT_POLYGON, -1, starts.size(), starts.data(), NULL,
+                                     points.size(), x.data(), y.data(), NULL, NULL);
+    SHPWriteObject(shp, -1, obj);
+    SHPDestroyObject(obj);
+    total += points.size();
+
+    DBFWriteIntegerAttribute(dbf, record, zoneField, record + 1);
+    DBFWriteStringAttribute(dbf, record, nameField, ("Zone " + std::to_string(record + 1)).c_str());
+    DBFWriteDoubleAttribute(dbf, record, areaField, area);
+  }
+  SHPClose(shp);
+  DBFClose(dbf);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if(openCells)
+    std::cout << "ERROR::SHPGEN::" << openCells << " cells were not closed by their neighbors" << std::endl;
+  std::cout << "Wrote " << zones << " zones (" << grid << " cells of a " << cols << "x"
+            << rows << " grid), " << total << " vertices, "
+            << (double) outer / grid << " per outer ring, to " << output << ".shp in "
+            << seconds << "s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,243 @@
+// tile-render: pre-renders an XYZ tile pyramid of a map with a pool of
+// headless contexts, one per worker thread, all drawing from the same
+// vertex buffer.
+//
+//   tile-render --map <shapefile> --zoom 8-12 [--bbox minX,minY,maxX,maxY]
+//               [--workers N] [--tile-size 256] [--output tiles] [--planar]
+//               [--fill fan|stencil|nonzero] [--aa] [--gpu-cull]
+//
+// By default the shapefile is taken as lon/lat and tiles follow the web
+// mercator XYZ scheme (the bbox is given in degrees). With --planar the data
+// is used as is and zoom level z splits the bbox's square extent in 2^z x 2^z
+// tiles (bbox in data units).
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "context.hpp"
+#include "image.hpp"
+#include "map.hpp"
+#include "renderer.hpp"
+#include "shader.hpp"
+
+struct Tile
+{
+  int z, x, y;
+};
+
+// Square tile grid: zoom 0 is one tile of `side` units with its top left
+// corner at (left, top), each level halves the tile size
+struct TileGrid
+{
+  double left, top, side;
+
+  double tileSize(int z) const { return side / (1 << z); }
+};
+
+// One offscreen context with its own program and VAO over the shared VBO
+struct Worker
+{
+  std::unique_ptr<HeadlessContext> context;
+  std::unique_ptr<Shader> shader;
+  std::unique_ptr<Shader> lineShader;
+  std::unique_ptr<Shader> cullShader;
+  std::unique_ptr<MapRenderer> renderer;
+};
+
+// view matrix taking normalized map space to the clip space of a tile
+static void tileView(const TileGrid &grid, const Map &map, const Tile &tile, float *view) {
+  double size = grid.tileSize(tile.z);
+  double x0 = grid.left + tile.x * size;
+  double y1 = grid.top - tile.y * size;
+  double y0 = y1 - size;
+
+  // clip = 2*(projected - corner)/size - 1, with projected = n/scale + center
+  std::fill(view, view + 16, 0.0f);
+  view[0] = 2.0 / (map.scale * size);
+  view[5] = 2.0 / (map.scale * size);
+  view[10] = 1.0f;
+  view[12] = 2.0 * (map.center[0] - x0) / size - 1.0;
+  view[13] = 2.0 * (map.center[1] - y0) / size - 1.0;
+  view[15] = 1.0f;
+}
+
+static void renderTiles(Worker &worker, const TileGrid &grid, const Map &map, const std::vector<Tile> &tiles,
+                        std::atomic<size_t> &next, int tileSize, const std::string &outputDir) {
+  worker.context->makeCurrent();
+
+  for(size_t i = next++; i < tiles.size(); i = next++) {
+    const Tile &tile = tiles[i];
+    tileView(grid, map, tile, worker.renderer->view);
+    worker.renderer->draw(*worker.shader);
+    Image image = readFramebuffer(worker.context->framebuffer(), tileSize, tileSize);
+
+    std::string dir = outputDir + "/" + std::to_string(tile.z) + "/" + std::to_string(tile.x);
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    writePNG(dir + "/" + std::to_string(tile.y) + ".png", image);
+  }
+
+  worker.context->doneCurrent();
+}
+
+int main(int argc, char** argv)
+{
+  const char* mapPath = DEFAULT_MAP_PATH;
+  std::string outputDir = "tiles";
+  int minZoom = 0, maxZoom = 4;
+  int workerCount = std::max(1u, std::thread::hardware_concurrency());
+  int tileSize = 256;
+  bool planar = false;
+  MapRenderer::FillMode fillMode = MapRenderer::FILL_FAN;
+  bool antialias = false;
+  bool gpuCulling = false;
+  bool hasBBox = false;
+  double bbox[4];
+
+  for(int i=1; i<argc; i++) {
+    std::string arg(argv[i]);
+    if(arg == "--map" && i+1 < argc)
+      mapPath = argv[++i];
+    else if(arg == "--output" && i+1 < argc)
+      outputDir = argv[++i];
+    else if(arg == "--workers" && i+1 < argc)
+      workerCount = std::max(1, atoi(argv[++i]));
+    else if(arg == "--tile-size" && i+1 < argc)
+      tileSize = std::max(1, atoi(argv[++i]));
+    else if(arg == "--planar")
+      planar = true;
+    else if(arg == "--aa")
+      antialias = true;
+    else if(arg == "--gpu-cull")
+      gpuCulling = true;
+    else if(arg == "--fill" && i+1 < argc && parseFillMode(argv[i+1], fillMode))
+      i++;
+    else if(arg == "--zoom" && i+1 < argc) {
+      if(sscanf(argv[++i], "%d-%d", &minZoom, &maxZoom) == 1)
+        maxZoom = minZoom;
+    }
+    else if(arg == "--bbox" && i+1 < argc)
+      hasBBox = sscanf(argv[++i], "%lf,%lf,%lf,%lf", &bbox[0], &bbox[1], &bbox[2], &bbox[3]) == 4;
+    else {
+      std::cout << "usage: tile-render --map <shapefile> --zoom <min>-<max> [--bbox minX,minY,maxX,maxY]"
+                   " [--workers N] [--tile-size px] [--output dir] [--planar]"
+                   " [--fill fan|stencil|nonzero] [--aa] [--gpu-cull]" << std::endl;
+      return -1;
+    }
+  }
+  maxZoom = std::min(maxZoom, 30);
+
+  // worker 0 owns the vertex buffer, every other context shares with it
+  std::vector<Worker> workers(workerCount);
+  for(int i=0; i<workerCount; i++) {
+    workers[i].context.reset(new HeadlessContext(tileSize, tileSize, i ? workers[0].context.get() : NULL));
+    if(!workers[i].context->valid() || !workers[i].context->loadGL())
+      return -1;
+    // programs are shared too, but uniforms live in the program object, so
+    // every worker gets its own (the program binary cache makes this cheap)
+    workers[i].shader.reset(new Shader("points.vert", "static_color.frag"));
+    if(antialias)
+      workers[i].lineShader.reset(new Shader("aa_line.vert", "aa_line.frag"));
+    // deep zoom levels only show a few shapes per tile
+    if(gpuCulling)
+      workers[i].cullShader.reset(new Shader("cull.comp"));
+  }
+
+  workers[0].context->makeCurrent();
+  Map map = loadMap(mapPath, !planar);
+  workers[0].renderer.reset(new MapRenderer(map));
+  workers[0].renderer->fillMode = fillMode;
+  workers[0].shader->finish();
+  if(antialias) {
+    workers[0].renderer->lineShader = workers[0].lineShader.get();
+    workers[0].lineShader->finish();
+  }
+  // the other contexts must see the upload complete before using the buffer
+  glFinish();
+  workers[0].context->doneCurrent();
+
+  for(int i=1; i<workerCount; i++) {
+    workers[i].context->makeCurrent();
+    workers[i].renderer.reset(new MapRenderer(*workers[0].renderer));
+    workers[i].renderer->fillMode = fillMode;
+    workers[i].shader->finish();
+    if(antialias) {
+      workers[i].renderer->lineShader = workers[i].lineShader.get();
+      workers[i].lineShader->finish();
+    }
+    workers[i].context->doneCurrent();
+  }
+  for(Worker &worker : workers) {
+    worker.renderer->viewport[0] = worker.renderer->viewport[1] = tileSize;
+    worker.renderer->cullShader = worker.cullShader.get();
+  }
+
+  // area to cover, in projected coordinates
+  double area[4] = { map.minBound[0], map.minBound[1], map.maxBound[0], map.maxBound[1] };
+  if(hasBBox) {
+    std::copy(bbox, bbox + 4, area);
+    if(!planar) {
+      projectWebMercator(area[0], area[1]);
+      projectWebMercator(area[2], area[3]);
+    }
+  }
+
+  TileGrid grid;
+  if(planar) {
+    grid.side = std::max(area[2] - area[0], area[3] - area[1]);
+    grid.left = area[0];
+    grid.top = area[1] + grid.side;
+  } else {
+    const double HALF_WORLD = M_PI * 6378137.0;
+    grid.side = 2 * HALF_WORLD;
+    grid.left = -HALF_WORLD;
+    grid.top = HALF_WORLD;
+  }
+
+  std::vector<Tile> tiles;
+  for(int z=minZoom; z<=maxZoom; z++) {
+    double size = grid.tileSize(z);
+    int last = (1 << z) - 1;
+    int x0 = std::max(0, (int) std::floor((area[0] - grid.left) / size));
+    int x1 = std::min(last, (int) std::floor((area[2] - grid.left) / size));
+    int y0 = std::max(0, (int) std::floor((grid.top - area[3]) / size));
+    int y1 = std::min(last, (int) std::floor((grid.top - area[1]) / size));
+    for(int x=x0; x<=x1; x++)
+      for(int y=y0; y<=y1; y++)
+        tiles.push_back({z, x, y});
+  }
+  std::cout << "Rendering " << tiles.size() << " tiles (zoom " << minZoom << "-" << maxZoom
+            << ") with " << workerCount << " workers" << std::endl;
+
+  auto start = std::chrono::steady_clock::now();
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for(int i=0; i<workerCount; i++)
+    threads.emplace_back(renderTiles, std::ref(workers[i]), std::cref(grid), std::cref(map),
+                         std::cref(tiles), std::ref(next), tileSize, std::cref(outputDir));
+  for(std::thread &thread : threads)
+    thread.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "Wrote " << tiles.size() << " tiles to " << outputDir << " in " << seconds << "s ("
+            << tiles.size() / std::max(seconds, 1e-9) << " tiles/s)" << std::endl;
+
+  // the shared buffer goes last, with worker 0's renderer
+  for(int i=workerCount-1; i>=0; i--) {
+    workers[i].context->makeCurrent();
+    workers[i].renderer.reset();
+    workers[i].context->doneCurrent();
+  }
+  return 0;
+}